@@ -102,6 +102,12 @@ stash any local changes and pull again, never commit changes made on the robot.
 #include "src/uplay.h"
 #include "src/uevent.h"
 #include "src/ujoy.h"
+#include "src/umission.h"
+#include "src/usequencer.h"
+#include "src/uprofiler.h"
+#include "src/uscheduler.h"
+#include "src/ulocalize.h"
+#include "src/utrigger.h"
 
 // to avoid writing std:: 
 using namespace std;
@@ -115,20 +121,56 @@ bool setup(int argc, char **argv)
     if (strcmp(argv[i], "help") == 0)
     { 
       printf("-----\n# User mission command line help\n");
-      printf("# usage:\n#   ./user_mission [help] [ball] [show] [aruco] [videoX]\n-----\n");
+      printf("# usage:\n#   ./user_mission [help] [ball] [line] [show] [aruco] [videoX] [file=name] [contour] [nogate] [camauto] [missions=file] [profile] [sim] [track=file] [simspeed=N] [poselog] [from=name] [resume] [landmarks=file] [cvthreads=N]\n");
+      printf("#   landmarks=file has marker positions for localization (default landmarks.txt)\n");
+      printf("#   from=name starts at this challenge (name or number), resume starts after the last finished challenge\n");
+      printf("#   line starts vision stream mode with the camera line and crossing detector (see vision.getLine())\n");
+      printf("#   sim uses a simulated robot (in place of the bridge), track=file is the line and wall layout\n");
+      printf("#   poselog saves all poses to pose_*.txt (for the speedprofile tool)\n");
+      printf("#   profile saves time and distance for each mission line to profile_*.txt\n");
+      printf("#   cvthreads=N sets OpenCV worker threads, 1 runs image processing in the vision thread only\n");
+      printf("#   file=name uses image files (e.g. file=sandberg_%%03d.png) or a video file in place of camera\n-----\n");
       return false;
     }
   }
+  // profile option is needed before the missions are loaded
+  profiler.setup(argc, argv);
+  // where to start the challenge sequence
+  sequencer.setup(argc, argv);
+  // landmarks to correct odometry
+  localize.setup(argc, argv);
+  // load and check all mission lines before the robot is used
+  if (not mission.setup(argc, argv))
+  {
+    printf("# Mission file has errors (or is missing)\n");
+    return false;
+  }
   // connect to robot hardware using bridge
   bridge.setup("127.0.0.1", "24001", argc, argv);
   if (true or bridge.connected)
   {  /// call setup for data structures
     pose.setup();
+    for (int i = 1; i < argc; i++)
+    {
+      if (strcmp(argv[i], "poselog") == 0)
+      {
+        const int MSL = 50;
+        char s[MSL], fn[MSL];
+        UTime t;
+        t.now();
+        snprintf(fn, MSL, "pose_%s.txt", t.getForFilename(s));
+        pose.openLog(fn);
+      }
+    }
     comment.setup();
     state.setup();
     vision.setup(argc, argv);
     event.setup();
     joy.setup();
+    // warn once when the battery is low (tested on every received message),
+    // no value until the first state message is received
+    triggers.addThreshold([](){ return state.t > 0 ? state.batteryVoltage : 99.0f; }, 11.1, false, 
+                          [](){ printf("# Battery is low (%.1f V), recharge after this run\n", state.batteryVoltage); });
     printf("# Setup finished OK\n");
   }
   else
@@ -137,376 +179,50 @@ bool setup(int argc, char **argv)
   return true;
 }
 
-// Follow the line to the right until the ramp objective
-void gillutineChallenge()
-{
-  sound.say("seventeen thirtyeight. Yah.", 0.75);
-  // remove old mission
-  bridge.tx("regbot mclear\n");
-  // clear events received from last mission
-  event.clearEvents();
-  // add mission lines
-
-  bridge.tx("regbot madd vel=0.5, edger=0:dist=2.5\n"); // follow the line to the right until the gillutine challenge
-  bridge.tx("regbot madd vel=0:time=1\n"); // wait under the challenge to flex
-  bridge.tx("regbot madd vel=0.25,edger=-1:time=5\n"); 
-  bridge.tx("regbot madd vel=0.25,edger=0:time=1\n"); 
-  
-  // start this mission
-  bridge.tx("regbot start\n");
-  // wait until finished
-  cout << "Waiting for step 1 to finish (event 0 is send, when mission is finished)\n";
-  event.waitForEvent(0);
-//   sound.say(". Step one finished.");
-}
-void seesawChallenge()
-{
-  //sound.say("And I can ride with my baby. I just left the mall, I'm getting fly with my baby, yeah.", 0.75);
-  // remove old mission
-  bridge.tx("regbot mclear\n");
-  event.clearEvents();
-  // clear events received from last mission
-  bridge.tx("regbot madd servo=1, pservo=2000, vservo=0:time=1\n");
-  bridge.tx("regbot madd vel=0.25,edgel=2:xl > 16\n");
-  bridge.tx("regbot madd vel=0.1:dist=0.1\n");
-  bridge.tx("regbot madd vel=0.1,tr=0:turn=90\n");
-
-  bridge.tx("regbot madd vel=0.25,edger=1:dist=0.2\n"); // catch the line
-  bridge.tx("regbot madd vel=0.25,edger=2:dist=0.8\n"); // drive to the ball - change dist from 0.8 to 0.85?
-  bridge.tx("regbot madd servo=1, pservo=-700, vservo=0:time=1\n"); //grab the ball
-  bridge.tx("regbot madd vel=-0.1:dist=0.165\n");
-  bridge.tx("regbot madd servo=1, pservo=-650, vservo=0:time=1\n");
-  bridge.tx("regbot madd vel=0.01,edger=0:lv<4\n"); // slowly drive down the ramp
-  bridge.tx("servo=1, pservo=-700, vservo=0:time=1\n"); // slightly raise arm to brace for impact
-
-  // Get to the goal
-  bridge.tx("regbot madd vel=0.25:xl>16\n");
-  bridge.tx("regbot madd vel=0.1:dist=0.1\n");
-  bridge.tx("regbot madd vel=0.1,tr=0:turn=-90\n");
-  bridge.tx("regbot madd vel=0.25,edger=0:lv<4\n"); // edger 0 -> 2?
-  bridge.tx("regbot madd vel=0.25:lv>4 \n"); 
-
-  // 12. apr: the robot turns after crossing the crossing point before goal - try to change to edgel??
-
-  // zero the distance on the goal
-  bridge.tx("regbot madd vel=0.1, edgel=-1:ir2 < 0.25\n"); // Attempt to fix by changing from edger=0 to edgel=-1?? - change from edger=0 to edger=2? 
-  bridge.tx("regbot madd vel=0.1,tr=0:turn=180\n");
-  //bridge.tx("regbot madd tr=0,vel=0.1:turn=180\n"); // try this turn instead?
-  bridge.tx("regbot madd vel=0.25,edgel=2:time=10\n");
-
-
-  // drive up the ramp to the post
-  bridge.tx("regbot madd vel=0.1,edgel=2:ir1 < 0.30\n");
-  bridge.tx("regbot madd servo=1, pservo=-750, vservo=0:time=1\n");
-  bridge.tx("regbot madd vel=0.25:dist=0.50\n"); 
-  // in order to get the ball in the hole, dist is increased from 0.45
-  // otherwise try with an extra iteration and 0.45
-
-
-  bridge.tx("regbot madd servo=1, pservo=-650, vservo=0:time=1\n");
-  bridge.tx("regbot madd label=1,vel=0.05, tr=0: turn=-50\n");
-  bridge.tx("regbot madd vel=0.1, tr=0: turn=50\n");
-  bridge.tx("regbot madd vel=0.1, tr=0: turn=50\n");
-  bridge.tx("regbot madd vel=0.1, tr=0: turn=-50\n");
-  bridge.tx("regbot madd vel=0.1:dist=0.05\n");
-  bridge.tx("regbot madd goto=1 : count = 1s\n");
-
-
-  bridge.tx("regbot madd servo=1, pservo=2000, vservo=0:time=1\n");
-  bridge.tx("regbot madd vel=0.1,tr=0:turn=-180\n");
-  bridge.tx("regbot madd vel=0.1:lv>4\n");
-
-/*
-servo=1, pservo=2000, vservo=0:time=1
-vel=0.25,edgel=2:xl > 16
-vel=0.1:dist=0.1
-vel=0.1,tr=0:turn=90
-
-vel=0.25,edger=1:dist=0.2
-vel=0.25,edger=2:dist=0.8
-servo=1, pservo=-700, vservo=0:time=1
-vel=-0.1:dist=0.165
-servo=1, pservo=-650, vservo=0:time=1
-vel=0.01,edger=0:lv<4
-servo=1, pservo=-700, vservo=0:time=1
-
-vel=0.25:xl>16
-vel=0.1:dist=0.1
-vel=0.1,tr=0:turn=-90
-vel=0.25,edger=0:lv<4
-vel=0.25:lv>4
-
-vel=0.25, edger=0:ir2 < 0.15
-vel=0.1,tr=0:turn=180
-vel=0.25,edgel=2:time=10
-vel=0.1,edgel=2:ir1 < 0.30
-servo=1, pservo=-750, vservo=0:time=1
-vel=0.25:dist=0.45
-
-servo=1, pservo=-650, vservo=0:time=1
-label=1,vel=0.05, tr=0: turn=-50
-vel=0.1, tr=0: turn=50
-vel=0.1, tr=0: turn=50
-vel=0.1, tr=0: turn=-50
-vel=0.1:dist=0.05
-goto=1 : count = 2
-
-servo=1, pservo=2000, vservo=0:time=1
-vel=0.1,tr=0:turn=180
-vel=0.1:lv>4
-
-*/
-   // start this mission
-  bridge.tx("regbot start\n");
-  event.waitForEvent(0);
-
-}
-
-void intermissionRotaryChallenge()
-{
-  bridge.tx("regbot mclear\n");
-  // clear events received from last mission
-  event.clearEvents();
-
-  
-  bridge.tx("regbot madd vel=0.25,edger=2:time=15\n"); // wait to flex
-  bridge.tx("regbot madd vel=0.25, edger=2:ir2 < 0.25\n"); // continue until just before the goal post
-  bridge.tx("regbot madd tr=0,vel=0.25:turn=180\n"); // turn the robot to face along the line
-  bridge.tx("regbot madd vel=0:time=1\n"); // wait to flex
-  bridge.tx("regbot madd vel=0.25,edger=-1:dist=1.25\n"); // countinue to the line going towards the rotating challenge
-  bridge.tx("regbot madd vel=0.25,edger=-2:xl>10\n"); // countinue to the line going towards the rotating challenge
-  bridge.tx("vel=0.1:dist=0.1\n"); // drive a little past the line so that the robot turns onto the track - 0.1->0.15->0.17
-  bridge.tx("regbot madd tr=0,vel=0.1:turn=-90\n"); // turn onto the path of the rotating challenge
-  bridge.tx("regbot madd vel=0.25,edgel=1:dist=0.2\n"); // added a line to catch the line, maybe change to edger?
-  // in order to make sure it catches the line; either decrease turning angle from 90 or increase dist before turn from 0.1
-
-  bridge.tx("regbot start\n");
-  event.waitForEvent(0);
-
-  /*
-  code for GUI test
-  vel=0.25, edger=0:ir2 < 0.15
-  tr=0,vel=0.25:turn=180
-  vel=0:time=1
-  vel=0.25,edger=-1:dist=1.25
-  vel=0.25,edger=-2:xl>6
-  vel=0.1:dist=0.1
-  tr=0.,vel=0.25:turn=-90
-  */
-}
-// Rotary challenge
-void rotaryChallenge()
-{
-  sound.say(". Trap queen.", 0.3);
-  // remove old mission
-  bridge.tx("regbot mclear\n");
-  // clear events received from last mission
-  event.clearEvents();
-
-  bridge.tx("regbot madd vel=0.1,edger=1:lv<4\n"); // Follow the line until the discontinuety in the line
-  bridge.tx("regbot madd tr=0.1,vel=0.25:turn=-90\n");  // Turn onto the other line
-  bridge.tx("regbot madd vel=0.05,edgel=0:ir2 < 0.2\n");// Drive until the robot is 25cm from the spining disk
-  bridge.tx("regbot madd vel=0: ir2 > 0.5\n");  // wait until the disk opening is regisered
-  bridge.tx("regbot madd vel=0: time=0.5\n"); // delay for disc to spin
-  bridge.tx("regbot madd vel=0.5,edger=0 : lv<4\n"); //quickly drive thrugh the gate when its open
-  bridge.tx("regbot madd vel=0.35: xl>16\n");//continue at a lower speed until a crossing line is registered
-  bridge.tx("regbot madd tr=0,vel=0.2:turn=-90\n");//turn the robot onto the line for the speedchallenge
-  bridge.tx("regbot start\n");// start this mission
-  
-  /*
-  vel=0.1,edger=1:lv<4
-  tr=0.1,vel=0.15:turn=-90
-  vel=0.05,edgel=0:ir2 < 0.2
-  vel=0: ir2 > 0.5
-  vel=0: time=0.5
-  vel=0.5,edger=0 : lv<4
-  vel=0.35: xl>16
-  tr=0,vel=0.2:turn=-90
-  */
-}
-
-// Speed challenge
-void speedChallenge()
-{
-  bridge.tx("regbot mclear\n");
-  event.clearEvents();
-
-    bridge.tx("regbot madd vel=0.5, edgel=0.0: dist=0.9\n"); // Drive to the start of the race track
-    bridge.tx("regbot madd vel=1.0, edgel=-1.0: dist=2.5\n"); // Speed up towards the first corner
-    bridge.tx("regbot madd servo=1, pservo=-550, vservo=0.2\n"); // Reset the speed to 1 on the long straight strech 
-    bridge.tx("regbot madd vel=1.0, edger=0.0: dist=2.8\n"); // drive through the goal
-    bridge.tx("regbot madd vel=1.0, edger=1.0: lv<10\n"); // drive through the goal
-    bridge.tx("regbot madd servo=1, pservo=3000, vservo=0\n"); // Reset the speed to 1 on the long straight strech 
-  // start this mission
-  bridge.tx("regbot start\n");
-
-  /*
-  vel=0.5, edgel=0.0: dist=0.9
-  vel=1.0, edgel=-1.0: dist=2.5
-  servo=1, pservo=-550, vservo=0
-  vel=1.0, edger=0.0: dist=2.8
-  vel=1.0, edger=-1.0: lv<6
-  servo=1, pservo=3000, vservo=0
-  */
-}
-    // recalibraation
-void intermissionTunelChallenge()
-{
-  bridge.tx("regbot mclear\n");
-  event.clearEvents();
-    bridge.tx("regbot madd vel=0.1:dist=0.5\n"); // drive a bit forward to get more line at the goal post
-    bridge.tx("regbot madd vel=0.1, tr=0: turn=-90\n"); // Turn the robot towards the tunnel challenge
-    bridge.tx("regbot madd vel=0.25:xl>16\n");  // Drive the robot forward to the first crossing line
-    bridge.tx("regbot madd vel=0.1, tr=0: turn=-90\n"); // turn the robot towards the goal
-    bridge.tx("regbot madd vel=0.1, edger=0:ir2 < 0.20\n"); // drive the robot 20cm from the goal post to obtain system percision
-    bridge.tx("regbot madd tr=0,vel=0.25:turn=180\n");  // turn the robot around
-    bridge.tx("regbot madd vel=0.25: dist=0.2\n"); // drive the robot 20cm further away from the goal post
-    bridge.tx("regbot madd vel=0.1, tr=0: turn=-90\n"); // turn the robot towards the tunnel challenge
-  // start this mission
-  bridge.tx("regbot start\n");
-
-  /*
-  vel=0.1:dist=0.25
-  vel=0.1, tr=0: turn=-90
-  vel=0.25:xl>16
-  vel=0.1, tr=0: turn=-90
-  vel=0.1, edger=0:ir2 < 0.20
-  tr=0,vel=0.25:turn=180
-  vel=0.1,edger=0: dist=0.1
-  vel=0.1, tr=0: turn=-90
-  */
-}
-
-// Tunnel challenge
-void tunnelChallenge()
-{
-  bridge.tx("regbot mclear\n");
-  event.clearEvents();
-
-  bridge.tx("regbot madd vel=0.25: ir2 < 0.10 \n"); // drive until the side of the tunnel challenge 
-  bridge.tx("regbot madd vel=0.0: time=1 \n"); // wait for one second
-  bridge.tx("regbot madd vel=0.1,tr=0:turn=-90 \n"); // turn towards the gate opening
-  bridge.tx("regbot madd vel=-0.25:ir1 > 0.5\n");
-  bridge.tx("regbot madd vel=0.1,tr=0:turn=10\n");
-  bridge.tx("regbot madd vel=0.2:dist=0.5\n");
-  bridge.tx("regbot madd vel=0.1,tr=0:turn=-10\n");
-  bridge.tx("regbot madd vel=0.125: ir2 > 0.10 \n"); //
-
-  bridge.tx("regbot madd vel=0.5:dist=0.2\n"); // 
-  bridge.tx("regbot madd vel=0.25:dist=0.5 \n"); //
-  bridge.tx("regbot madd vel=0.25,tr=0.0:turn=90\n"); //
-  bridge.tx("regbot madd vel=0.25:dist=0.45\n"); //
-  bridge.tx("regbot madd vel=0.25,tr=0.0:turn=97\n"); //
-  bridge.tx("regbot madd vel=0.25: ir2 < 0.1\n"); //
-  bridge.tx("regbot madd vel=0.0: time=1\n"); //
-
-  bridge.tx("regbot madd vel=0.25:dist=0.6\n"); //
-  bridge.tx("regbot madd vel=0.25,tr=0.0:turn=-97\n"); //
-  bridge.tx("regbot madd vel=0.25: xl > 6\n"); //
-  bridge.tx("regbot madd vel=0.25:dist=0.1");
-  bridge.tx("regbot madd vel=0.25,tr=0.0:turn=-90\n"); //
-  bridge.tx("refbot madd vel=0.25,edger=0: dist=0.6\n"); //
-  bridge.tx("regbot madd vel=0.25,tr=0.0:turn=-90\n"); //
-
-  bridge.tx("regbot madd vel=0.25: ir2 < 0.1\n"); //
-  bridge.tx("regbot madd vel=0.25,tr=0.0:turn=90\n"); //
-  bridge.tx("regbot madd vel=0.25:dist=0.5\n"); //
-  bridge.tx("regbot madd vel=0.25,tr=0.0:turn=-90\n"); //
-  bridge.tx("refbot madd vel=0.5: dist=0.2\n"); //
-  bridge.tx("regbot madd vel=0.25: dist=1\n"); //
-
-  bridge.tx("regbot madd vel=0.25,tr=0.0:turn=-90\n"); //
-  bridge.tx("regbot madd vel=0.25: dist=1\n"); //
-  bridge.tx("regbot madd vel=0.25,tr=0.0:turn=90\n"); //
-  bridge.tx("regbot madd vel=0.25: xl > 6\n"); //
-  bridge.tx("regbot madd vel=0.25,tr=0.0:turn=90\n"); //
-  bridge.tx("regbot madd vel=0.1, edger=0: ir2 < 0.1\n"); //
-  bridge.tx("regbot madd vel=0.25,tr=0.0:turn=180\n"); //
-  bridge.tx("regbot madd vel=0.25: dist=0.75\n");
-  bridge.tx("regbot madd vel=0.25,tr=0.0:turn=-90\n");
-  bridge.tx("regbot madd vel=0.25: xl > 6\n");
-  bridge.tx("regbot madd vel=0.25:dist=0.1\n");
-  bridge.tx("regbot madd vel=0.25,tr=0.0:turn=-90\n");
-
-  /*
-fixed code
-// Drive into box
-vel=0.25: ir2 < 0.1
-vel=0.0: time=1
-vel=0.1,tr=0:turn=-90
-vel=-0.25:ir1 > 0.5
-vel=0.1,tr=0:turn=10
-vel=0.2:dist=0.5
-vel=0.1,tr=0:turn=-10
-vel=0.125: ir2 < 0.10
-
-vel=0.5:dist=0.2
-vel=0.25:dist=0.5
-vel=0.25,tr=0.0:turn=90
-vel=0.25:dist=0.45
-vel=0.25,tr=0.0:turn=95
-vel=0.25: ir2 < 0.1
-vel=0.0: time=1
-
-vel=0.25:dist=0.6
-vel=0.25,tr=0.0:turn=-95
-vel=0.25: xl > 6
-vel=0.25:dist=0.1
-vel=0.25,tr=0.0:turn=-90
-vel=0.25,edger=0: dist=0.6
-vel=0.25,tr=0.0:turn=-90
-
-vel=0.25: ir2 < 0.1
-vel=0.25,tr=0.0:turn=90
-vel=0.25:dist=0.5
-vel=0.25,tr=0.0:turn=-90
-vel=0.5: dist=0.2
-vel=0.25: dist=1
-
-vel=0.25,tr=0.0:turn=-90
-vel=0.25: dist=1
-vel=0.25,tr=0.0:turn=90
-vel=0.25: xl > 6
-vel=0.25,tr=0.0:turn=90
-vel=0.1, edger=0: ir2 < 0.1
-vel=0.25,tr=0.0:turn=180
-vel=0.25: dist=0.75
-vel=0.25,tr=0.0:turn=-90
-vel=0.25: xl > 6
-vel=0.25:dist=0.1
-vel=0.25,tr=0.0:turn=-90
-  
-  */
-
-  // start this mission
-  bridge.tx("regbot start\n");
-}
-
-void goalChallenge()
-{
-  bridge.tx("regbot mclear\n");
-  event.clearEvents();
-
-  bridge.tx("regbot madd servo=1, pservo=3000, vservo=0:time=1\n");
-  bridge.tx("regbot madd vel=0.5,edger=0:lv<4\n");
-  bridge.tx("regbot madd vel=0.5,tr=0.25:turn=-90\n");
-  bridge.tx("regbot madd vel=0.5:xl>16\n");
-  bridge.tx("regbot madd vel=0.5,tr=0.25:turn=-90\n");
-  bridge.tx("regbot madd servo=1, pservo=-650, vservo=0:time=1\n");
-  bridge.tx("regbot madd vel=0.5,edger=0:ir<20\n");
-
-  bridge.tx("regbot start\n");
-  /*
-  servo=1, pservo=3000, vservo=0:time=1
-vel=0.5,edger=0:lv<4
-vel=0.5,tr=0.25:turn=-90
-vel=0.5:xl>16
-vel=0.5,tr=0.25:turn=-90
-servo=1, pservo=-650, vservo=0:time=1
-vel=0.5,edger=0:ir<20
-  */
-
-
+// The mission lines for each challenge are in missions.txt,
+// loaded and checked by mission.setup(..).
+// The sequencer sends the next challenge as soon as the last is finished (event 0),
+// the sentences are spoken while the challenge runs.
+// A challenge that does not finish within the timeout is stopped,
+// and the operator can retry or skip it (see usequencer.h).
+// The timeout is from the run time measured last time (steptimes.txt),
+// so there is no timeout the first time a challenge is run.
+// When landmark positions are measured (landmarks.txt), an intermission can
+// get a localized variant without the goal post calibration (see usequencer.h).
+void addChallenges()
+{ // timeouts are for the first run, later runs use the measured run time,
+  // region size is the distance (m) from where the last full run ended
+  USequencer::UStep * s;
+  // Follow the line to the right until the ramp objective
+  s = &sequencer.add("guillotine", [](){ scheduler.spawn(scheduler.say("seventeen thirtyeight. Yah.", 0.75)); });
+  s->defaultTimeout = 30;
+  s->regionSize = 0.4;
+  // complete the seesaw challenge, the retry delivers the ball again from the ramp
+  s = &sequencer.add("seesaw");
+  s->defaultTimeout = 120;
+  s->fallback = "seesaw retry";
+  s->regionSize = 0.5;
+  // Intermission to the rotary challenge with odometry calibration reset
+  s = &sequencer.add("intermission rotary");
+  s->defaultTimeout = 60;
+  s->regionSize = 0.5;
+  // Rotary challenge, the retry waits for the gate again
+  s = &sequencer.add("rotary", [](){ scheduler.spawn(scheduler.say(". Trap queen.", 0.3)); });
+  s->defaultTimeout = 60;
+  s->fallback = "rotary retry";
+  // Racing challenge
+  s = &sequencer.add("speed");
+  s->defaultTimeout = 20;
+  // Intermission from racetrack to tunnel challenge with odometry calibration reset
+  s = &sequencer.add("intermission tunnel");
+  s->defaultTimeout = 45;
+  // Tunnel challenge
+  s = &sequencer.add("tunnel");
+  s->defaultTimeout = 120;
+  // goto goal (final), the retry finds the line to the goal wall
+  s = &sequencer.add("goal");
+  s->defaultTimeout = 30;
+  s->fallback = "goal retry";
 }
 
 int main(int argc, char **argv) 
@@ -515,16 +231,11 @@ int main(int argc, char **argv)
   { // start mission
     std::cout << "# Robobot mission starting ...\n";
     //
-    gillutineChallenge(); // gillutine
-    seesawChallenge(); // complete the sesaw challenge
-    intermissionRotaryChallenge(); // Intermission to the rotarychallenge with odometry calibration reset
-    rotaryChallenge(); // rotary challenge
-    speedChallenge();  // Racing challenge
-    intermissionTunelChallenge(); // // Intermission from racetrack to tunnel challenge with odometry calibration reset
-    tunnelChallenge(); //tunnel challenge
-    goalChallenge(); // goto goal (final)
-     
-
+    addChallenges();
+    sequencer.run();
+    profiler.report();
+    localize.report();
+    triggers.printStats();
     //
     std::cout << "# Robobot mission finished ...\n";
     // remember to close camera
@@ -533,6 +244,7 @@ int main(int argc, char **argv)
     while (sound.isSaying())
       sleep(1);
     bridge.tx("regbot mute 1\n");
+    pose.closeLog();
   }
   return 0;
 }
@@ -0,0 +1,248 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, 
+ * Author:
+ * Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+#include <math.h>
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/calib3d.hpp>
+#include <opencv2/core/utility.hpp>
+#include "uaruco.h"
+
+#if __has_include(<opencv2/objdetect/aruco_dictionary.hpp>)
+  // OpenCV 4.7 and newer
+  #include <opencv2/objdetect/aruco_dictionary.hpp>
+  #define UARUCO_HAS_DICT
+#elif __has_include(<opencv2/aruco.hpp>)
+  // opencv_contrib
+  #include <opencv2/aruco.hpp>
+  #define UARUCO_HAS_DICT
+#endif
+
+#ifdef UARUCO_HAS_DICT
+/// marker dictionary (bit patterns)
+static cv::aruco::Dictionary dict;
+/// older versions return a pointer
+static const cv::aruco::Dictionary & deref(const cv::aruco::Dictionary & d) { return d; }
+static const cv::aruco::Dictionary & deref(const cv::Ptr<cv::aruco::Dictionary> & d) { return *d; }
+#endif
+
+
+bool UAruco::setup()
+{
+#ifdef UARUCO_HAS_DICT
+  dict = deref(cv::aruco::getPredefinedDictionary(cv::aruco::DICT_4X4_100));
+  markerBits = dict.markerSize;
+  available = true;
+  printf("# UAruco:: using %dx%d marker dictionary, marker size %.3f m\n", markerBits, markerBits, markerSize);
+#else
+  printf("# UAruco:: no aruco module in this OpenCV, markers are not decoded\n");
+#endif
+  return available;
+}
+
+int UAruco::detect(const cv::Mat & frame, const cv::Mat1f & camToRobot,
+                   float focal, float k1, float k2, UArucoResult & r)
+{
+  UTime t, t0;
+  t.now();
+  t0.now();
+  r.markerCnt = 0;
+  // candidates from a downscaled image
+  cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+  cv::resize(gray, small, cv::Size(gray.cols / scale, gray.rows / scale), 0, 0, cv::INTER_AREA);
+  cv::adaptiveThreshold(small, bw, 255, cv::ADAPTIVE_THRESH_MEAN_C, cv::THRESH_BINARY_INV, 7, 7);
+  thresholdTime = t.getTimePassed();
+  t.now();
+  contours.clear();
+  cv::findContours(bw, contours, cv::RETR_LIST, cv::CHAIN_APPROX_NONE);
+  quads.resize(contours.size());
+  cv::parallel_for_(cv::Range(0, contours.size()), [&](const cv::Range & range)
+  { // test candidates in parallel
+    for (int i = range.start; i < range.end; i++)
+      testQuad(contours[i], quads[i]);
+  });
+  // keep usable quads only
+  quads.erase(std::remove_if(quads.begin(), quads.end(), 
+                             [](const UQuad & q) { return not q.ok; }), quads.end());
+  removeDuplicates();
+  candidateCnt = quads.size();
+  quadTime = t.getTimePassed();
+  t.now();
+  if (available)
+  { // decode and find pose in parallel using the full image
+    float cx = frame.cols / 2.0f;
+    float cy = frame.rows / 2.0f;
+    cv::Mat cameraMatrix = (cv::Mat_<double>(3,3) << focal, 0, cx, 0, focal, cy, 0, 0, 1);
+    cv::Mat distortion = (cv::Mat_<double>(1,4) << k1, k2, 0, 0);
+    cv::parallel_for_(cv::Range(0, quads.size()), [&](const cv::Range & range)
+    {
+      for (int i = range.start; i < range.end; i++)
+      {
+        quads[i].ok = decode(gray, quads[i]);
+        if (quads[i].ok)
+          findPose(quads[i], cameraMatrix, distortion, camToRobot);
+      }
+    });
+    for (const UQuad & q : quads)
+    {
+      if (q.ok and r.markerCnt < UArucoResult::MAX_MARKERS)
+        r.marker[r.markerCnt++] = q.marker;
+    }
+  }
+  decodeTime = t.getTimePassed();
+  r.detectTime = t0.getTimePassed();
+  return r.markerCnt;
+}
+
+void UAruco::testQuad(const vector<cv::Point> & contour, UQuad & q)
+{
+  q.ok = false;
+  if ((int)contour.size() < 4 * minSide)
+    return;
+  vector<cv::Point> poly;
+  double perimeter = cv::arcLength(contour, true);
+  cv::approxPolyDP(contour, poly, perimeter * 0.05, true);
+  if (poly.size() != 4 or not cv::isContourConvex(poly))
+    return;
+  for (int j = 0; j < 4; j++)
+  { // all sides must be long enough
+    cv::Point d = poly[j] - poly[(j + 1) % 4];
+    if (d.x * d.x + d.y * d.y < minSide * minSide)
+      return;
+  }
+  // corners in full image, and clockwise (in image)
+  for (int j = 0; j < 4; j++)
+    q.c[j] = cv::Point2f((poly[j].x + 0.5f) * scale - 0.5f, (poly[j].y + 0.5f) * scale - 0.5f);
+  cv::Point2f d1 = q.c[1] - q.c[0];
+  cv::Point2f d2 = q.c[2] - q.c[0];
+  if (d1.x * d2.y - d1.y * d2.x < 0)
+    std::swap(q.c[1], q.c[3]);
+  q.perimeter = perimeter * scale;
+  q.ok = true;
+}
+
+void UAruco::removeDuplicates()
+{ // the inner and outer edge of the black border gives two candidates,
+  // keep the outer (largest)
+  for (int i = 0; i < (int)quads.size(); i++)
+  {
+    for (int j = i + 1; j < (int)quads.size(); j++)
+    {
+      float sum = 0;
+      for (int a = 0; a < 4; a++)
+      {
+        float best = 1e9;
+        for (int b = 0; b < 4; b++)
+        {
+          cv::Point2f d = quads[i].c[a] - quads[j].c[b];
+          best = std::min(best, d.x * d.x + d.y * d.y);
+        }
+        sum += sqrtf(best);
+      }
+      // the border is one bit wide
+      float side = std::min(quads[i].perimeter, quads[j].perimeter) / 4;
+      if (sum / 4 < side / (markerBits + 2) * 1.5f)
+      {
+        if (quads[i].perimeter < quads[j].perimeter)
+          quads[i].ok = false;
+        else
+          quads[j].ok = false;
+      }
+    }
+  }
+  quads.erase(std::remove_if(quads.begin(), quads.end(), 
+                             [](const UQuad & q) { return not q.ok; }), quads.end());
+}
+
+bool UAruco::decode(const cv::Mat & gray, UQuad & q)
+{
+#ifdef UARUCO_HAS_DICT
+  // refine corners in full image
+  vector<cv::Point2f> corners(q.c, q.c + 4);
+  cv::cornerSubPix(gray, corners, cv::Size(scale + 1, scale + 1), cv::Size(-1, -1),
+                   cv::TermCriteria(cv::TermCriteria::MAX_ITER | cv::TermCriteria::EPS, 10, 0.05));
+  // get marker area only, with a few pixels for each bit
+  const int cellPx = 6;
+  const int cells = markerBits + 2;
+  const float side = cells * cellPx;
+  cv::Point2f dst[4] = {cv::Point2f(0, 0), cv::Point2f(side - 1, 0), 
+                        cv::Point2f(side - 1, side - 1), cv::Point2f(0, side - 1)};
+  cv::Mat h = cv::getPerspectiveTransform(corners.data(), dst);
+  cv::Mat img;
+  cv::warpPerspective(gray, img, h, cv::Size(side, side), cv::INTER_NEAREST);
+  cv::threshold(img, img, 125, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+  // read bits, and count white cells in border
+  cv::Mat bits(markerBits, markerBits, CV_8UC1);
+  int borderErr = 0;
+  const int inner = cellPx - 2;
+  for (int y = 0; y < cells; y++)
+  {
+    for (int x = 0; x < cells; x++)
+    {
+      int n = cv::countNonZero(img(cv::Rect(x * cellPx + 1, y * cellPx + 1, inner, inner)));
+      bool white = n > inner * inner / 2;
+      if (x == 0 or y == 0 or x == cells - 1 or y == cells - 1)
+        borderErr += white;
+      else
+        bits.at<uchar>(y - 1, x - 1) = white;
+    }
+  }
+  if (borderErr > (cells - 1) * 4 * 0.35)
+    return false;
+  if (not dict.identify(bits, q.id, q.rotation, 0.6))
+    return false;
+  // corners from the marker top-left corner
+  std::rotate(corners.begin(), corners.begin() + 4 - q.rotation, corners.end());
+  for (int j = 0; j < 4; j++)
+    q.marker.corners[j] = corners[j];
+  q.marker.id = q.id;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void UAruco::findPose(UQuad & q, const cv::Mat & cameraMatrix, const cv::Mat & distortion, 
+                      const cv::Mat1f & camToRobot)
+{
+  const float s = markerSize / 2;
+  vector<cv::Point3f> obj = {cv::Point3f(-s, s, 0), cv::Point3f(s, s, 0), 
+                             cv::Point3f(s, -s, 0), cv::Point3f(-s, -s, 0)};
+  vector<cv::Point2f> img(q.marker.corners, q.marker.corners + 4);
+  cv::Vec3d rvec, tvec;
+  cv::solvePnP(obj, img, cameraMatrix, distortion, rvec, tvec, false, cv::SOLVEPNP_IPPE_SQUARE);
+  // camera coordinates (x right, y down, z forward) to (x forward, y left, z up)
+  cv::Vec4f posCam(tvec[2], -tvec[0], -tvec[1], 1.0f);
+  cv::Mat1f pos = camToRobot * posCam;
+  q.marker.pos = cv::Vec3f(pos.at<float>(0), pos.at<float>(1), pos.at<float>(2));
+  q.marker.dist = sqrt(tvec[0] * tvec[0] + tvec[1] * tvec[1] + tvec[2] * tvec[2]);
+  // marker normal (z-axis) in robot coordinates
+  cv::Mat1d rot;
+  cv::Rodrigues(rvec, rot);
+  float nc[3] = {float(rot(2, 2)), float(-rot(0, 2)), float(-rot(1, 2))};
+  float nr[2];
+  for (int i = 0; i < 2; i++)
+    nr[i] = camToRobot(i, 0) * nc[0] + camToRobot(i, 1) * nc[1] + camToRobot(i, 2) * nc[2];
+  q.marker.heading = atan2f(nr[1], nr[0]);
+}
@@ -0,0 +1,142 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#ifndef UARUCO_H
+#define UARUCO_H
+
+#include <vector>
+#include <opencv2/core.hpp>
+#include "utime.h"
+
+using namespace std;
+
+/**
+ * One ArUco marker found in an image */
+class UArucoMarker
+{
+public:
+  /// marker ID in the dictionary
+  int id = -1;
+  /// corners in image pixels, clockwise from the marker top-left corner
+  cv::Point2f corners[4];
+  /// marker center in robot coordinates (x (forward), y (left), z (up)) in meters
+  cv::Vec3f pos;
+  /// direction of the marker front (normal) in robot coordinates (radians),
+  /// a marker facing the robot has a heading of about pi
+  float heading = 0;
+  /// distance from camera to marker center (meters)
+  float dist = 0;
+};
+
+/**
+ * Markers found in one image frame */
+class UArucoResult
+{
+public:
+  static const int MAX_MARKERS = 10;
+  /// serial number of the frame (from the capture loop)
+  int frameSerial = -1;
+  /// time the frame was captured
+  UTime imageTime;
+  /// number of found markers
+  int markerCnt = 0;
+  UArucoMarker marker[MAX_MARKERS];
+  /// time used to find markers (seconds)
+  float detectTime = 0;
+};
+
+/**
+ * ArUco marker detector.
+ * Candidate quadrangles are found with an adaptive threshold on a
+ * downscaled image and filtered in parallel.
+ * Marker bits are decoded (in parallel) in the full resolution image,
+ * but only inside the candidates, and the pose is found with solvePnP.
+ * Marker decoding needs the aruco module (opencv_contrib or OpenCV 4.7+). */
+class UAruco
+{
+public:
+  /**
+   * Load the marker dictionary
+   * \returns false if no aruco support */
+  bool setup();
+  /**
+   * Find markers in an image.
+   * \param frame is the full BGR image.
+   * \param camToRobot is the camera to robot coordinate transformation (4x4).
+   * \param focal is the focal length in pixels (at this image size).
+   * \param k1,k2 is radial lens distortion.
+   * \param r is set to the result (frameSerial and imageTime must be set in advance).
+   * \returns number of markers */
+  int detect(const cv::Mat & frame, const cv::Mat1f & camToRobot,
+             float focal, float k1, float k2, UArucoResult & r);
+  /// marker side length - the black square (meters)
+  float markerSize = 0.1;
+  /// downscale factor for finding candidates
+  int scale = 2;
+  /// minimum marker side length in downscaled image (pixels)
+  int minSide = 8;
+  /// aruco module is available and dictionary loaded
+  bool available = false;
+  /// time for each stage in last frame (seconds)
+  float thresholdTime = 0;
+  float quadTime = 0;
+  float decodeTime = 0;
+  /// number of candidates in last frame
+  int candidateCnt = 0;
+  
+private:
+  /**
+   * A candidate marker (quadrangle) */
+  class UQuad
+  {
+  public:
+    cv::Point2f c[4];
+    float perimeter = 0;
+    bool ok = false;
+    int id = -1;
+    int rotation = 0;
+    UArucoMarker marker;
+  };
+  /**
+   * Decode marker bits inside a candidate in the full image.
+   * \returns true if a valid marker ID is found */
+  bool decode(const cv::Mat & gray, UQuad & q);
+  /**
+   * Find marker pose from corners */
+  void findPose(UQuad & q, const cv::Mat & cameraMatrix, const cv::Mat & distortion, 
+                const cv::Mat1f & camToRobot);
+  /// test if contour is a usable quadrangle
+  void testQuad(const vector<cv::Point> & contour, UQuad & q);
+  /// remove the inner edge of markers (same marker found twice)
+  void removeDuplicates();
+  /// number of bits in marker (without border)
+  int markerBits = 4;
+  /// reused images and candidates
+  cv::Mat gray;
+  cv::Mat small;
+  cv::Mat bw;
+  vector<vector<cv::Point> > contours;
+  vector<UQuad> quads;
+};
+
+#endif
@@ -0,0 +1,158 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, 
+ * Author:
+ * Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+#include <math.h>
+#include "uballtrack.h"
+
+
+void UBallTrack::setup(float focalLength)
+{ // state is (x, y, vx, vy) in pixels and pixels/sec
+  // measurement is ball center (x, y)
+  focal = focalLength;
+  kf.init(4, 2, 0, CV_32F);
+  cv::setIdentity(kf.transitionMatrix);
+  kf.measurementMatrix = cv::Mat::zeros(2, 4, CV_32F);
+  kf.measurementMatrix.at<float>(0, 0) = 1;
+  kf.measurementMatrix.at<float>(1, 1) = 1;
+  // position noise from detection (pixels^2)
+  cv::setIdentity(kf.measurementNoiseCov, cv::Scalar(4));
+  reset();
+}
+
+void UBallTrack::reset()
+{
+  valid = false;
+  missCnt = 0;
+  framesSinceFull = 0;
+}
+
+void UBallTrack::predict(UTime imageTime, float heading)
+{
+  float dt = 0.04;
+  if (lastValid)
+    dt = imageTime - lastTime;
+  lastTime = imageTime;
+  // heading change since last image
+  float dh = heading - lastHeading;
+  if (dh > M_PI)
+    dh -= 2 * M_PI;
+  else if (dh < -M_PI)
+    dh += 2 * M_PI;
+  if (not lastValid)
+    dh = 0;
+  lastHeading = heading;
+  lastValid = true;
+  framesSinceFull++;
+  if (not valid)
+    return;
+  // robot turning left (positive) moves the image to the right
+  kf.statePost.at<float>(0) += dh * focal;
+  // constant velocity model
+  kf.transitionMatrix.at<float>(0, 2) = dt;
+  kf.transitionMatrix.at<float>(1, 3) = dt;
+  // acceleration noise (pixels/s^2), and extra position noise from turning
+  float q = 2000 * dt;
+  float qh = fabsf(dh) * focal * 0.1f;
+  cv::setIdentity(kf.processNoiseCov, cv::Scalar(q * dt));
+  kf.processNoiseCov.at<float>(0, 0) += qh * qh;
+  kf.processNoiseCov.at<float>(1, 1) += qh * qh;
+  kf.processNoiseCov.at<float>(2, 2) = q;
+  kf.processNoiseCov.at<float>(3, 3) = q;
+  cv::Mat s = kf.predict();
+  pos = cv::Point2f(s.at<float>(0), s.at<float>(1));
+  vel = cv::Point2f(s.at<float>(2), s.at<float>(3));
+  // search margin is 3 sigma of position, and at least a ball diameter
+  float sigma = sqrtf(std::max(kf.errorCovPre.at<float>(0, 0), kf.errorCovPre.at<float>(1, 1)));
+  gate = std::max(3 * sigma, diameter) + diameter / 2;
+}
+
+bool UBallTrack::needFullSearch()
+{
+  return not valid or framesSinceFull >= fullSearchFrames;
+}
+
+cv::Rect UBallTrack::roi(cv::Size imageSize)
+{
+  int x1 = std::max(0, int(pos.x - gate));
+  int y1 = std::max(0, int(pos.y - gate));
+  int x2 = std::min(imageSize.width, int(pos.x + gate + 1));
+  int y2 = std::min(imageSize.height, int(pos.y + gate + 1));
+  if (x2 <= x1 or y2 <= y1)
+    // predicted outside image
+    return cv::Rect(0, 0, imageSize.width, imageSize.height);
+  return cv::Rect(x1, y1, x2 - x1, y2 - y1);
+}
+
+void UBallTrack::update(const vector<cv::Rect> & balls)
+{
+  if (needFullSearch())
+    framesSinceFull = 0;
+  // find ball closest to prediction
+  int best = -1;
+  float bestDist = 1e9;
+  for (int i = 0; i < (int)balls.size(); i++)
+  {
+    const cv::Rect & bb = balls[i];
+    cv::Point2f c(bb.x + bb.width / 2.0f, bb.y + bb.height / 2.0f);
+    float d = 0;
+    if (valid)
+      d = hypotf(c.x - pos.x, c.y - pos.y);
+    else
+      // start on the biggest (closest) ball
+      d = -bb.area();
+    if (d < bestDist and (not valid or d < gate))
+    {
+      best = i;
+      bestDist = d;
+    }
+  }
+  if (best < 0)
+  { // not seen in this image
+    missCnt++;
+    if (missCnt > maxMissCnt)
+      valid = false;
+    return;
+  }
+  const cv::Rect & bb = balls[best];
+  cv::Point2f c(bb.x + bb.width / 2.0f, bb.y + bb.height / 2.0f);
+  float dia = std::max(bb.width, bb.height);
+  if (not valid)
+  { // start a new track
+    kf.statePost = (cv::Mat_<float>(4, 1) << c.x, c.y, 0.f, 0.f);
+    cv::setIdentity(kf.errorCovPost, cv::Scalar(10));
+    kf.errorCovPost.at<float>(2, 2) = 1e4;
+    kf.errorCovPost.at<float>(3, 3) = 1e4;
+    diameter = dia;
+    valid = true;
+  }
+  else
+  {
+    cv::Mat m = (cv::Mat_<float>(2, 1) << c.x, c.y);
+    kf.correct(m);
+    diameter = 0.7 * diameter + 0.3 * dia;
+  }
+  pos = cv::Point2f(kf.statePost.at<float>(0), kf.statePost.at<float>(1));
+  vel = cv::Point2f(kf.statePost.at<float>(2), kf.statePost.at<float>(3));
+  missCnt = 0;
+}
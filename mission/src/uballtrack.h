@@ -0,0 +1,95 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#ifndef UBALLTRACK_H
+#define UBALLTRACK_H
+
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/video/tracking.hpp>
+#include "utime.h"
+
+using namespace std;
+
+/**
+ * Track one ball across image frames with a constant velocity
+ * Kalman filter in image coordinates (pixels).
+ * The prediction is corrected for robot rotation (odometry heading),
+ * and gives a region of interest (ROI), so that only a small part
+ * of the image needs to be searched, when the ball is tracked. */
+class UBallTrack
+{
+public:
+  /**
+   * Set camera focal length (pixels), used for heading correction */
+  void setup(float focalLength);
+  /**
+   * Predict ball position at the time of a new image.
+   * \param imageTime is the capture time of the new image.
+   * \param heading is the robot odometry heading (radians) at that time. */
+  void predict(UTime imageTime, float heading);
+  /**
+   * Should the full image be searched.
+   * True if no ball is tracked, or at a low rate (every fullSearchFrames)
+   * to find new balls. */
+  bool needFullSearch();
+  /**
+   * Region of interest around the predicted ball position,
+   * clipped to the image size. */
+  cv::Rect roi(cv::Size imageSize);
+  /**
+   * Correct the track with the balls found in the new image.
+   * The ball closest to the prediction is used (within the ROI gate). */
+  void update(const vector<cv::Rect> & balls);
+  /**
+   * Stop tracking */
+  void reset();
+  
+public:
+  /// a ball is tracked
+  bool valid = false;
+  /// tracked ball center (pixels)
+  cv::Point2f pos;
+  /// tracked ball velocity (pixels per second)
+  cv::Point2f vel;
+  /// tracked ball diameter (pixels)
+  float diameter = 0;
+  /// number of frames since the ball was seen
+  int missCnt = 0;
+  /// search full image at least every this number of frames
+  int fullSearchFrames = 12;
+  /// frames without the ball before the track is lost
+  int maxMissCnt = 3;
+  
+private:
+  cv::KalmanFilter kf;
+  float focal = 1008;
+  UTime lastTime;
+  float lastHeading = 0;
+  bool lastValid = false;
+  int framesSinceFull = 0;
+  /// search margin (pixels) around predicted ball
+  float gate = 0;
+};
+
+#endif
@@ -31,6 +31,9 @@
 #include "ustate.h"
 #include "uvision.h"
 #include "uevent.h"
+#include "uscheduler.h"
+#include "utrigger.h"
+#include "usimcore.h"
 #include "ujoy.h"
 
 // create the bridge connection
@@ -46,6 +49,10 @@ void UBridge::decode(char* msg)
   else if (joy.decode(msg)) {}
   else
     printf("Received, but not used: %s\n", msg);
+  // host side triggers on the new data
+  triggers.evaluate();
+  // mission tasks may wait for this data
+  scheduler.notify();
 }
 
 void shutdown(int signal)
@@ -70,6 +77,11 @@ void UBridge::setup(const char ip[], const char port[], int argc, char **argv)
     if (strcmp(argv[i], "nobridge") == 0)
       usebridge = false;
   }
+  if (simcore.setup(argc, argv))
+  { // robot is simulated, no bridge connection
+    usebridge = false;
+    simulated = true;
+  }
   /// Setup socket to use
   if (usebridge)
   {
@@ -101,7 +113,10 @@ void UBridge::setup(const char ip[], const char port[], int argc, char **argv)
   }
   else
   {
-    printf("# Running without bridge connection\n");
+    if (simulated)
+      printf("# Running with a simulated robot\n");
+    else
+      printf("# Running without bridge connection\n");
     // set the connected flag anyhow
     connected = true;
   }
@@ -117,7 +132,12 @@ UBridge::~UBridge()
 
 void UBridge::stop()
 {
-  if (connected)
+  if (simulated)
+  {
+    simcore.stop();
+    connected = false;
+  }
+  if (connected and usebridge)
   { // tell bridge we are done
     connected = false;
     // wait for it to suck in
@@ -129,57 +149,110 @@ void UBridge::stop()
 }
 
 
+const char * UBridge::frameLine(const char * msg, string & dest)
+{
+  const char * p1 = msg;
+  int sum = 0;
+  while (*p1 == ' ' or *p1 == '\t')
+    // skip space and tabulator characters
+    p1++;
+  // save start of message line
+  const char * p2 = p1;
+  while (*p1 != '\n' and *p1 != '\0')
+  { // sum all non-white characters
+    if (*p1 >= ' ')
+      sum += *p1;
+    p1++;
+  }
+  if (p1 > p2)
+  {
+    const int MCL = 4;
+    char crc[MCL];
+    /// calculate a number in range [01..99] as CRC after a ';' key
+    snprintf(crc, MCL, ";%02d", sum % 99 + 1);
+    dest.append(crc, 3);
+    // the message - ending with a new-line (\n)
+    dest.append(p2, p1 - p2);
+    dest.append("\n");
+  }
+  if (*p1 == '\n')
+    p1++;
+  return p1;
+}
+
 void UBridge::tx(const char * msg)
 { // adding CRC check
-  int n = strlen(msg);
   const char * p1 = msg;
-  const char * p2;
   sendMtx.lock();
   if (connected and not terminate and usebridge)
   {
-    while (*p1 != '\0' and n > 1)
+    while (*p1 != '\0')
     { // there is more data
-      int sum = 0;
-      while ((*p1 == ' ' or *p1 == '\t') and *p1 != '\0')
-        // skip space and tabulator characters
-        p1++;
-      // save start of message line
-      p2 = p1;
-      while (*p1 != '\n' and *p1 != '\0')
-      { // sum all non-white characters
-        if (*p1 >= ' ')
-          sum += *p1;
-        p1++;
-        // count remaining characters
-        n--;
-      }
-      const int MCL = 4;
-      char crc[MCL];
-      /// calculate a number in range [01..99] as CRC after a ';' key
-      snprintf(crc, MCL, ";%02d", sum % 99 + 1);
-      //
-      if (connected)
-      { /// send CRC first
-        send(sockfd, crc, 3, 0);
+      string line;
+      p1 = frameLine(p1, line);
+      if (connected and not line.empty())
+      { /// send CRC and message line
+        send(sockfd, line.data(), line.size(), 0);
+//       printf("# user mission send (%d):  '%s'\n", connected, line.c_str());
+        // should not be needed
+        usleep(4000);
       }
-      if (connected)
-      { /// then the message - ending with a new-line (\n)
-        p1++; // include also the '\n' character
-        int len = p1 - p2; // including 
-        send(sockfd, msg, len, 0);
-      }
-//       printf("# user mission send (%d):  '%s%s'\n", connected, crc, msg);
-      // should not be needed
-      usleep(4000);
     }
   }
   sendMtx.unlock();
-  if (not usebridge)
+  if (simulated)
+    simcore.receive(msg);
+  else if (not usebridge)
   {
     printf("# bridge would send:%s", msg);
   }
 }
 
+int UBridge::sendAll(const char * data, int cnt)
+{
+  int n = 0;
+  while (n < cnt)
+  {
+    int e = send(sockfd, data + n, cnt - n, MSG_NOSIGNAL);
+    if (e < 0 and errno == EINTR)
+      continue;
+    if (e <= 0)
+    {
+      perror("# UBridge:: send failed");
+      break;
+    }
+    n += e;
+  }
+  return n;
+}
+
+int UBridge::txFramed(const string & data)
+{
+  int n = 0;
+  sendMtx.lock();
+  if (connected and not terminate and usebridge)
+  {
+    n = sendAll(data.data(), data.size());
+    if (n < (int)data.size())
+    {
+      printf("# UBridge:: sent %d of %d bytes only\n", n, (int)data.size());
+      n = -1;
+    }
+  }
+  sendMtx.unlock();
+  if (simulated)
+  {
+    simcore.receive(data.c_str());
+    n = data.size();
+  }
+  else if (not usebridge)
+  {
+    printf("# bridge would send %d bytes:\n%s", (int)data.size(), data.c_str());
+    n = data.size();
+  }
+  return n;
+}
+
 void UBridge::startloop(UBridge * bridge)
 { // this is a static method for the class,
   // transfer control to the used class object
@@ -236,6 +309,15 @@ void UBridge::loop()
   }
 }
 
+void UBridge::simReceive(const string & line)
+{ // copy, as the message is changed when unpacked
+  const int MAX_RX_CNT = 500;
+  char rxBuf[MAX_RX_CNT];
+  strncpy(rxBuf, line.c_str(), MAX_RX_CNT - 1);
+  rxBuf[MAX_RX_CNT - 1] = '\0';
+  unpackMessage(rxBuf);
+}
+
 void UBridge::unpackMessage(char * msg)
 { // strip CRC and newline
   if (msg[0] == ';')
@@ -38,6 +38,7 @@
 #include <unistd.h>
 #include <math.h>
 #include <signal.h>
+#include <string>
 
 using namespace std;
 // forward declaration
@@ -54,8 +55,25 @@ public:
   /**
    * Send command lines to hardware (via bridge) */
   void tx(const char * msg);
+  /**
+   * Send lines that already have a CRC (see frameLine) in one burst,
+   * i.e. with no delay between lines. The CRC lets the bridge reject
+   * a damaged line, so the pause used by tx(...) is not needed.
+   * \returns number of bytes sent, or -1 if not all data is sent */
+  int txFramed(const string & data);
+  /**
+   * Add CRC to the first line in a message (as used by tx(...))
+   * \param msg is the message, one or more lines
+   * \param dest is the string the line with CRC and new-line is added to
+   * (nothing is added for an empty line)
+   * \returns pointer to the next line in msg */
+  static const char * frameLine(const char * msg, string & dest);
   /** Stop connection to bridge */
   void stop(); 
+  /**
+   * Message line from the simulator (with CRC),
+   * decoded as if received from the bridge */
+  void simReceive(const string & line);
   
 public:
   /// connected to hardware through bridge 
@@ -65,6 +83,10 @@ public:
   bool terminate = false; // shutdown flag
   
 private:
+  /**
+   * Send all data, send() may send a part only
+   * \returns number of bytes sent */
+  int sendAll(const char * data, int cnt);
   addrinfo * servinfo = nullptr; /// socket info
   int sockfd; /// Socket file descriptor
   mutex sendMtx; /// to avoid too many are sending at the same time
@@ -79,6 +101,8 @@ private:
   struct sigaction sigIntHandler;
   // testflag to test code without the bridge (e.g. vision)
   bool usebridge = true;
+  /// a simulated robot is used in place of the bridge ('sim' option)
+  bool simulated = false;
 };
 
 /**
@@ -0,0 +1,139 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, 
+ * Author:
+ * Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+#include <stdio.h>
+#include <string.h>
+#include <opencv2/core/utility.hpp>
+#include "ucolourtable.h"
+
+
+UColourTable::UColourTable()
+{ // orange golf ball, as used in the ball detector
+  used[ORANGE] = true;
+  strncpy(name[ORANGE], "orange", 16);
+  colour[ORANGE] = cv::Vec3b(128, 88, 187);
+  limit[ORANGE] = 25;
+  // blue ball - NB! not calibrated
+  used[BLUE] = true;
+  strncpy(name[BLUE], "blue", 16);
+  colour[BLUE] = cv::Vec3b(128, 170, 100);
+  limit[BLUE] = 25;
+  build();
+}
+
+bool UColourTable::setClass(int id, const char * className, cv::Vec3b yuv, int matchLimit)
+{
+  if (id <= 0 or id >= MAX_CLASSES)
+    return false;
+  used[id] = true;
+  strncpy(name[id], className, 16);
+  name[id][15] = '\0';
+  colour[id] = yuv;
+  limit[id] = matchLimit;
+  build();
+  return true;
+}
+
+void UColourTable::removeClass(int id)
+{
+  if (id > 0 and id < MAX_CLASSES)
+  {
+    used[id] = false;
+    build();
+  }
+}
+
+void UColourTable::build()
+{ // find the closest class for all (U,V) values
+  for (int u = 0; u < 256; u++)
+  {
+    for (int v = 0; v < 256; v++)
+    {
+      int best = 0;
+      int bestDist = 256;
+      for (int k = 1; k < MAX_CLASSES; k++)
+      {
+        if (used[k])
+        { // block distance in U,V
+          int d = abs(u - colour[k][1]) + abs(v - colour[k][2]);
+          if (d < limit[k] and d < bestDist)
+          {
+            best = k;
+            bestDist = d;
+          }
+        }
+      }
+      if (best > 0)
+        table[u * 256 + v] = (best << 8) | (255 - bestDist);
+      else
+        table[u * 256 + v] = 0;
+    }
+  }
+}
+
+void UColourTable::classify(const cv::Mat & yuv, cv::Mat & classImg, cv::Mat & matchImg)
+{
+  classImg.create(yuv.rows, yuv.cols, CV_8UC1);
+  matchImg.create(yuv.rows, yuv.cols, CV_8UC1);
+  const uint16_t * lut = table;
+  // rows are split into stripes for all CPU cores
+  cv::parallel_for_(cv::Range(0, yuv.rows), [&](const cv::Range & rows)
+  {
+    for (int r = rows.start; r < rows.end; r++)
+    { // no branches, so that the compiler may vectorize the lookups (gather)
+      const uchar * __restrict pix = yuv.ptr(r);
+      uchar * __restrict cls = classImg.ptr(r);
+      uchar * __restrict mat = matchImg.ptr(r);
+      for (int c = 0; c < yuv.cols; c++)
+      {
+        uint16_t e = lut[(pix[3 * c + 1] << 8) | pix[3 * c + 2]];
+        cls[c] = e >> 8;
+        mat[c] = e & 0xff;
+      }
+    }
+  });
+}
+
+void UColourTable::extract(const cv::Mat & classImg, const cv::Mat & matchImg, int id, cv::Mat & dest)
+{
+  dest.create(classImg.rows, classImg.cols, CV_8UC1);
+  for (int r = 0; r < classImg.rows; r++)
+  {
+    const uchar * __restrict cls = classImg.ptr(r);
+    const uchar * __restrict mat = matchImg.ptr(r);
+    uchar * __restrict d = dest.ptr(r);
+    for (int c = 0; c < classImg.cols; c++)
+      d[c] = (cls[c] == id) ? mat[c] : 0;
+  }
+}
+
+void UColourTable::print()
+{
+  for (int k = 1; k < MAX_CLASSES; k++)
+  {
+    if (used[k])
+      printf("# colour class %d '%s' YUV=(%d,%d,%d) limit %d\n", k, name[k], 
+             colour[k][0], colour[k][1], colour[k][2], limit[k]);
+  }
+}
@@ -0,0 +1,86 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#ifndef UCOLOURTABLE_H
+#define UCOLOURTABLE_H
+
+#include <stdint.h>
+#include <opencv2/core.hpp>
+
+/**
+ * Colour classification of YUV pixels using a lookup table on chroma (U,V).
+ * The table is made once (and again when a colour class is changed),
+ * and gives class and colour match for all colour classes at once,
+ * so one lookup per pixel classifies an image for all targets. */
+class UColourTable
+{
+public:
+  /// class 0 is 'no match'
+  static const int MAX_CLASSES = 8;
+  /// default classes
+  static const int ORANGE = 1;
+  static const int BLUE = 2;
+  /**
+   * Constructor, makes table with default colour classes */
+  UColourTable();
+  /**
+   * Set (or add) a colour class and rebuild the table.
+   * \param id is class number (1..MAX_CLASSES-1)
+   * \param name is a short name for the class
+   * \param yuv is the colour (only U and V is used)
+   * \param limit pixels must have a U,V block distance less than this to match
+   * \returns false if id is out of range */
+  bool setClass(int id, const char * name, cv::Vec3b yuv, int limit);
+  /**
+   * Remove colour class and rebuild table */
+  void removeClass(int id);
+  /**
+   * Classify all pixels in an image.
+   * \param yuv is the source image (CV_8UC3 in Y,U,V order)
+   * \param classImg is set to the class number for each pixel (CV_8U), 0 is no match.
+   * \param matchImg is set to the colour match 255 - distance (CV_8U), 0 if no match. */
+  void classify(const cv::Mat & yuv, cv::Mat & classImg, cv::Mat & matchImg);
+  /**
+   * Get colour match for one class only
+   * \param classImg and matchImg are from classify()
+   * \param id is the class to get
+   * \param dest is set to the colour match where the class is 'id', else 0 */
+  static void extract(const cv::Mat & classImg, const cv::Mat & matchImg, int id, cv::Mat & dest);
+  /**
+   * Print defined classes */
+  void print();
+  
+private:
+  /**
+   * Make table from class colours */
+  void build();
+  /// class colours and limits
+  bool used[MAX_CLASSES] = {false};
+  char name[MAX_CLASSES][16];
+  cv::Vec3b colour[MAX_CLASSES];
+  int limit[MAX_CLASSES];
+  /// table with class (high byte) and match (low byte) index is U * 256 + V
+  uint16_t table[256 * 256];
+};
+
+#endif
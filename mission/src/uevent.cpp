@@ -25,6 +25,8 @@
 #include <string>
 #include <string.h>
 #include "uevent.h"
+#include "uprofiler.h"
+#include "upose.h"
 #include "ubridge.h"
 #include "ustate.h"
 
@@ -51,6 +53,8 @@ bool UEvent::decode(char* msg)
     else
       return false;
     // decode data
+    UTime t;
+    t.now();
     dataLock.lock();
     // time in seconds
     int e = strtol(p1, (char**)&p1, 10);
@@ -60,8 +64,13 @@ bool UEvent::decode(char* msg)
         // start mission
         clearEvents();
       events[e] = true;
+      times[e] = t;
     }
     dataLock.unlock();
+    // wake anyone waiting for this event
+    newEvent.notify_all();
+    profiler.onEvent(e, t);
+    pose.logEvent(e);
   }
   else
     used = false;
@@ -92,15 +101,28 @@ bool UEvent::gotEvent(int i)
   return result;
 }
 
+UTime UEvent::eventTime(int i)
+{
+  UTime t;
+  dataLock.lock();
+  if (i >= 0 and i < MAX_EVENT)
+    t = times[i];
+  dataLock.unlock();
+  return t;
+}
+
 bool UEvent::waitForEvent(int n)
 {
-  int m = 0;
+  UTime t;
+  t.now();
   bool result = true;
-  while (not gotEvent(n))
-  { // wait 50ms
-    usleep(50000);
-    m++;
-    if (state.controlState == 0 and m > 20)
+  bool valid = n >= 0 and n < MAX_EVENT;
+  unique_lock<mutex> lock(dataLock);
+  // test and wait under the same lock, so a new event is not missed
+  while (not newEvent.wait_for(lock, chrono::milliseconds(50), 
+                               [this, n, valid](){ return bridge.terminate or (valid and events[n]); }))
+  { // waited 50ms with no event, the mission may not be started
+    if (state.controlState == 0 and t.getTimePassed() > 1.0)
     { // mission is not started (waited a second for heartbeat status)
       // so an event will never happen
       // so stop waiting
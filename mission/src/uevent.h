@@ -32,11 +32,13 @@
 #include <netdb.h>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <math.h>
+#include "utime.h"
 
 using namespace std;
 // forward declaration
@@ -65,11 +67,19 @@ public:
    * \param n is the event to wait for.
    * \returns true if the event has arrived and false if no mission is running */
   bool waitForEvent(int n);
+  /**
+   * Time the event was received (last time)
+   * \param i is event index (0 to 33)
+   * \returns the time (not valid if the event has never been received) */
+  UTime eventTime(int i);
 
 private:
   static const int MAX_EVENT = 34;
   bool events[MAX_EVENT] = {false};
+  UTime times[MAX_EVENT];
   mutex dataLock;
+  /// to wake threads waiting for an event
+  condition_variable newEvent;
 };
 
 /**
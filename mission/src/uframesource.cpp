@@ -0,0 +1,239 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, 
+ * Author:
+ * Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+#include <stdio.h>
+#include <string.h>
+#include "uframesource.h"
+
+
+bool UFrameSource::openCamera(int dev)
+{
+  isFile = false;
+  frameCnt = 0;
+  width = 0;
+  height = 0;
+  fps = 0;
+  format[0] = '\0';
+  snprintf(name, MNL, "/dev/video%d", dev);
+  int apiID = cv::CAP_V4L2;  //cv::CAP_ANY;  // 0 = autodetect default API
+  cap.open(dev, apiID);
+  if (not cap.isOpened())
+    return false;
+  // possible resolutions in JPEG coding
+  // (rows x columns) 320x640, 720x1280
+  setMode(1280, 720, 25, "MJPG");
+  printf("# Video device %d: width=%d, height=%d, format=%s, FPS=%g\n", 
+          dev, width, height, format, fps);
+  return true;
+}
+
+bool UFrameSource::setMode(int w, int h, float framerate, const char * fourcc)
+{
+  if (isFile or not cap.isOpened())
+    return false;
+  // the driver restarts the stream for each changed value,
+  // so set only what is changed
+  union FourChar
+  {
+    uint32_t cc4;
+    char ccc[4];
+  } fmt;
+  if (fourcc != nullptr and strlen(fourcc) == 4 and strncmp(fourcc, format, 4) != 0)
+  {
+    fmt.cc4 = cv::VideoWriter::fourcc(fourcc[0], fourcc[1], fourcc[2], fourcc[3]);
+    cap.set(cv::CAP_PROP_FOURCC, fmt.cc4);
+  }
+  if (h != height)
+    cap.set(cv::CAP_PROP_FRAME_HEIGHT, h);
+  if (w != width)
+    cap.set(cv::CAP_PROP_FRAME_WIDTH, w);
+  if (framerate != fps)
+    cap.set(cv::CAP_PROP_FPS, framerate);
+  // get the mode actually used
+  width = cap.get(cv::CAP_PROP_FRAME_WIDTH);
+  height = cap.get(cv::CAP_PROP_FRAME_HEIGHT);
+  fps = cap.get(cv::CAP_PROP_FPS);
+  fmt.cc4 = cap.get(cv::CAP_PROP_FOURCC);
+  memcpy(format, fmt.ccc, 4);
+  format[4] = '\0';
+  return width == w and height == h;
+}
+
+bool UFrameSource::saveSettings(const char * filename)
+{
+  if (isFile or not cap.isOpened())
+    return false;
+  // V4L2 exposure mode: 1 is manual, 3 is auto (0.25 and 0.75 in older OpenCV)
+  double mode = cap.get(cv::CAP_PROP_AUTO_EXPOSURE);
+  bool manualExposure = mode == 1 or mode == 0.25;
+  bool manualWb = cap.get(cv::CAP_PROP_AUTO_WB) == 0;
+  FILE * f = fopen(filename, "w");
+  if (f == nullptr)
+    return false;
+  if (manualExposure)
+  { // the values in use
+    fprintf(f, "# camera settings for %s, manual exposure\n", name);
+    fprintf(f, "exposure %g\n", cap.get(cv::CAP_PROP_EXPOSURE));
+    fprintf(f, "gain %g\n", cap.get(cv::CAP_PROP_GAIN));
+  }
+  else
+  { // in auto mode the driver returns the last manual exposure (and gain),
+    // not the value in use, so save the auto state only
+    fprintf(f, "# camera settings for %s, auto exposure\n", name);
+    fprintf(f, "auto_exposure 1\n");
+  }
+  if (manualWb)
+    fprintf(f, "wb_temperature %g\n", cap.get(cv::CAP_PROP_WB_TEMPERATURE));
+  else
+    fprintf(f, "auto_wb 1\n");
+  fclose(f);
+  return true;
+}
+
+bool UFrameSource::loadSettings(const char * filename)
+{
+  if (isFile or not cap.isOpened())
+    return false;
+  FILE * f = fopen(filename, "r");
+  if (f == nullptr)
+    return false;
+  float exposure = -1, gain = -1, wb = -1;
+  int autoExposure = 0;
+  const int MLL = 200;
+  char line[MLL];
+  while (fgets(line, MLL, f) != nullptr)
+  { // lines are 'name value', or a comment
+    if (line[0] == '#')
+      continue;
+    sscanf(line, "exposure %f", &exposure);
+    sscanf(line, "gain %f", &gain);
+    sscanf(line, "wb_temperature %f", &wb);
+    sscanf(line, "auto_exposure %d", &autoExposure);
+  }
+  fclose(f);
+  if (autoExposure)
+    // saved in auto mode, there is no exposure to use
+    exposure = -1;
+  if (exposure >= 0)
+  { // V4L2 exposure mode: 1 is manual, 3 is auto
+    cap.set(cv::CAP_PROP_AUTO_EXPOSURE, 1);
+    cap.set(cv::CAP_PROP_EXPOSURE, exposure);
+  }
+  if (gain >= 0)
+    cap.set(cv::CAP_PROP_GAIN, gain);
+  if (wb > 0)
+  {
+    cap.set(cv::CAP_PROP_AUTO_WB, 0);
+    cap.set(cv::CAP_PROP_WB_TEMPERATURE, wb);
+  }
+  manualSettings = exposure >= 0;
+  printf("# Camera settings from %s: exposure %g, gain %g, white balance %gK\n",
+         filename, exposure, gain, wb);
+  return manualSettings;
+}
+
+void UFrameSource::setAuto()
+{
+  if (isFile or not cap.isOpened())
+    return;
+  cap.set(cv::CAP_PROP_AUTO_EXPOSURE, 3);
+  cap.set(cv::CAP_PROP_AUTO_WB, 1);
+  manualSettings = false;
+}
+
+bool UFrameSource::openFile(const char * filename)
+{
+  isFile = true;
+  frameCnt = 0;
+  strncpy(name, filename, MNL - 1);
+  if (strchr(filename, '%') != nullptr)
+    // numbered still images
+    cap.open(filename, cv::CAP_IMAGES);
+  else
+    // video file (decoder by file type)
+    cap.open(filename, cv::CAP_ANY);
+  if (not cap.isOpened())
+  {
+    printf("# UFrameSource:: failed to open '%s'\n", filename);
+    return false;
+  }
+  printf("# Frame source file '%s' has %g frames\n", filename, cap.get(cv::CAP_PROP_FRAME_COUNT));
+  return true;
+}
+
+bool UFrameSource::grab()
+{
+  bool grabbed = cap.grab();
+  if (not grabbed and isFile and loopFile and frameCnt > 0)
+  { // end of file, start again
+    rewind();
+    grabbed = cap.grab();
+  }
+  if (grabbed)
+    frameCnt++;
+  return grabbed;
+}
+
+bool UFrameSource::retrieve(cv::Mat & img)
+{
+  return cap.retrieve(img) and not img.empty();
+}
+
+bool UFrameSource::read(cv::Mat & img)
+{
+  return grab() and retrieve(img);
+}
+
+bool UFrameSource::rewind()
+{
+  if (not isFile)
+    return false;
+  // an image sequence can not always seek, so open again
+  cap.release();
+  if (strchr(name, '%') != nullptr)
+    cap.open(name, cv::CAP_IMAGES);
+  else
+    cap.open(name, cv::CAP_ANY);
+  return cap.isOpened();
+}
+
+void UFrameSource::release()
+{
+  cap.release();
+}
+
+bool UFrameSource::isOpen()
+{
+  return cap.isOpened();
+}
+
+double UFrameSource::get(int property)
+{
+  return cap.get(property);
+}
+
+bool UFrameSource::set(int property, double value)
+{
+  return cap.set(property, value);
+}
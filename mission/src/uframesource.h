@@ -0,0 +1,121 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#ifndef UFRAMESOURCE_H
+#define UFRAMESOURCE_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+using namespace std;
+
+/**
+ * Source of image frames for the vision module.
+ * Frames are from a camera (/dev/videoN) or from a file, either
+ * a still image sequence, e.g. "sandberg_%03d.png" (as saved by
+ * the vision 'save' option), or a video file (MJPEG, AVI).
+ * A camera delivers frames in real time, and old frames are dropped,
+ * a file delivers every frame in sequence. */
+class UFrameSource
+{
+public:
+  /**
+   * Open camera device, and set MJPEG format, 1280x720 and 25 FPS
+   * \param dev is the video device number (/dev/videoN)
+   * \returns true if opened */
+  bool openCamera(int dev);
+  /**
+   * Change capture mode (camera only).
+   * The camera stays open, but the driver restarts the stream,
+   * this may take some 100 ms.
+   * \param w,h is the image size in pixels, e.g. 1280x720 or 640x360
+   * \param framerate is frames per second
+   * \param fourcc is the format, e.g. "MJPG" or "YUYV", nullptr for no change
+   * \returns true if the camera accepted the image size */
+  bool setMode(int w, int h, float framerate, const char * fourcc);
+  /**
+   * Save exposure, gain and white balance in use to a file (camera only).
+   * In auto mode the V4L2 driver reports the last manual exposure, not the
+   * one in use, so only the auto state is saved, and the next run
+   * uses auto exposure too. Manual settings are saved as they are.
+   * \returns false if file could not be saved */
+  bool saveSettings(const char * filename);
+  /**
+   * Load exposure, gain and white balance from a file, and use them as
+   * manual settings, so that no time is needed for auto exposure.
+   * \returns false if there is no file, no camera or the file has auto exposure */
+  bool loadSettings(const char * filename);
+  /**
+   * Use automatic exposure and white balance */
+  void setAuto();
+  /// exposure and white balance are manual (from a settings file)
+  bool manualSettings = false;
+  /**
+   * Open image sequence or video file
+   * \param filename is a video file name, or an image sequence with
+   * a printf style number, like "sandberg_%03d.png"
+   * \returns true if opened */
+  bool openFile(const char * filename);
+  /**
+   * Grab next frame (not decoded).
+   * \returns false at end of file (or camera error) */
+  bool grab();
+  /**
+   * Decode the last grabbed frame
+   * \returns false if no frame */
+  bool retrieve(cv::Mat & img);
+  /**
+   * Grab and decode next frame */
+  bool read(cv::Mat & img);
+  /**
+   * Start from first frame again (file only) */
+  bool rewind();
+  /**
+   * Close camera or file */
+  void release();
+  /** \returns true if a camera or file is open */
+  bool isOpen();
+  /** get or set a capture property (cv::CAP_PROP_xxx) */
+  double get(int property);
+  bool set(int property, double value);
+  /// source is a file (not a camera)
+  bool isFile = false;
+  /// start file from first frame when the end is reached
+  bool loopFile = false;
+  /// frames delivered since opened
+  int frameCnt = 0;
+  /// capture mode in use (camera only)
+  int width = 0;
+  int height = 0;
+  float fps = 0;
+  char format[5] = "";
+  /// name of file or device
+  static const int MNL = 200;
+  char name[MNL] = "";
+  
+private:
+  /// openCV video capture function
+  cv::VideoCapture cap;
+};
+
+#endif
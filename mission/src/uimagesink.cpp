@@ -0,0 +1,224 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, 
+ * Author:
+ * Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+#include <string.h>
+#include <unistd.h>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/highgui.hpp>
+#include "uimagesink.h"
+#include "utime.h"
+
+// create the image sink
+UImageSink imageSink;
+
+
+UImageSink::~UImageSink()
+{
+  stop();
+}
+
+bool UImageSink::save(const char* filename, const cv::Mat& img)
+{
+  if (img.empty())
+    return false;
+  queueLock.lock();
+  int slot = -1;
+  if (queueCnt < MAX_SLOTS and not terminate)
+  { // find a free slot
+    for (int i = 0; i < MAX_SLOTS; i++)
+    {
+      if (not slots[i].used)
+      {
+        slot = i;
+        break;
+      }
+    }
+  }
+  if (slot < 0)
+  { // writer is behind - drop this image
+    droppedCnt++;
+    queueLock.unlock();
+    return false;
+  }
+  USlot & s = slots[slot];
+  s.used = true;
+  queueLock.unlock();
+  // copy into the slot buffer - no allocation when size is unchanged
+  strncpy(s.name, filename, MNL);
+  s.name[MNL - 1] = '\0';
+  img.copyTo(s.img);
+  // add to queue
+  queueLock.lock();
+  queue[(queueHead + queueCnt) % MAX_SLOTS] = slot;
+  queueCnt++;
+  startWriter();
+  queueLock.unlock();
+  return true;
+}
+
+bool UImageSink::show(const char* window, const cv::Mat& img)
+{
+  if (img.empty())
+    return false;
+  queueLock.lock();
+  // find the slot for this window, or a new one
+  UWindow * w = nullptr;
+  for (int i = 0; i < MAX_WINDOWS and not terminate; i++)
+  {
+    if (windows[i].name[0] == '\0')
+    { // first use of this window
+      w = &windows[i];
+      strncpy(w->name, window, MNL);
+      w->name[MNL - 1] = '\0';
+      break;
+    }
+    if (strncmp(windows[i].name, window, MNL - 1) == 0)
+    {
+      w = &windows[i];
+      break;
+    }
+  }
+  if (w == nullptr or w->busy)
+  { // too many windows, or this window is being shown - drop this image
+    if (w != nullptr)
+      w->droppedCnt++;
+    droppedCnt++;
+    queueLock.unlock();
+    return false;
+  }
+  if (w->pending)
+  { // the older image was never shown, it is replaced
+    w->droppedCnt++;
+    droppedCnt++;
+  }
+  w->busy = true;
+  queueLock.unlock();
+  // copy into the window buffer - no allocation when size is unchanged
+  img.copyTo(w->img);
+  queueLock.lock();
+  w->pending = true;
+  w->busy = false;
+  startWriter();
+  queueLock.unlock();
+  return true;
+}
+
+void UImageSink::startWriter()
+{
+  if (writer == nullptr)
+    writer = new thread(startloop, this);
+}
+
+void UImageSink::startloop(UImageSink* sink)
+{ // start writer loop (thread)
+  sink->loop();
+}
+
+bool UImageSink::showWindows()
+{ // show the latest image for all windows with a new image
+  bool shown = false;
+  for (int i = 0; i < MAX_WINDOWS; i++)
+  {
+    UWindow & w = windows[i];
+    queueLock.lock();
+    bool ready = w.pending and not w.busy;
+    if (ready)
+    {
+      w.pending = false;
+      w.busy = true;
+    }
+    queueLock.unlock();
+    if (ready)
+    {
+      cv::imshow(w.name, w.img);
+      windowsOpen = true;
+      w.shownCnt++;
+      shownCnt++;
+      shown = true;
+      queueLock.lock();
+      w.busy = false;
+      queueLock.unlock();
+    }
+  }
+  return shown;
+}
+
+void UImageSink::loop()
+{
+  while (true)
+  {
+    int slot = -1;
+    queueLock.lock();
+    if (queueCnt > 0)
+    {
+      slot = queue[queueHead];
+      queueHead = (queueHead + 1) % MAX_SLOTS;
+      queueCnt--;
+    }
+    queueLock.unlock();
+    if (slot >= 0)
+    {
+      USlot & s = slots[slot];
+      UTime t;
+      t.now();
+      cv::imwrite(s.name, s.img);
+      savedCnt++;
+      printf("# image sink: saved %s in %.3f sec\n", s.name, t.getTimePassed());
+      queueLock.lock();
+      s.used = false;
+      queueLock.unlock();
+    }
+    bool shown = showWindows();
+    if (shown)
+      // let HighGUI draw the new images
+      cv::waitKey(1);
+    else if (slot >= 0)
+      continue;
+    else if (terminate)
+      break;
+    else if (windowsOpen)
+      // update windows, and wait a bit
+      cv::waitKey(5);
+    else
+      usleep(5000);
+  }
+}
+
+void UImageSink::stop()
+{
+  if (writer != nullptr)
+  { // finish queued images
+    terminate = true;
+    writer->join();
+    writer = nullptr;
+    printStats();
+  }
+}
+
+void UImageSink::printStats()
+{
+  printf("# image sink: saved %d, shown %d, dropped %d images\n", savedCnt, shownCnt, droppedCnt);
+  for (int i = 0; i < MAX_WINDOWS and windows[i].name[0] != '\0'; i++)
+    printf("#    window '%s': shown %d, dropped %d\n", windows[i].name, windows[i].shownCnt, windows[i].droppedCnt);
+}
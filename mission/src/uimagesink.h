@@ -0,0 +1,123 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#ifndef UIMAGESINK_H
+#define UIMAGESINK_H
+
+#include <thread>
+#include <mutex>
+#include <opencv2/core.hpp>
+
+using namespace std;
+
+/**
+ * Background writer for debug images.
+ * Images are copied to one of a few preallocated slots and saved
+ * (or shown) by a separate thread, so that no file encoding or
+ * window update is done in the image processing thread.
+ * All HighGUI calls are made by this thread.
+ * If all save slots are in use, the new image is dropped.
+ * Each window has its own slot holding the latest image only,
+ * so a busy window drops its own images, not those of other windows.
+ * The file format is given by the file extension,
+ * e.g. '.jpg' for JPEG, '.ppm' or '.pgm' for raw (uncompressed) or '.png'. */
+class UImageSink
+{
+public:
+  /** stop thread */
+  ~UImageSink();
+  /**
+   * Save image to a file in the background.
+   * \param filename is the file name (and format by extension).
+   * \param img is the image - it is copied.
+   * \returns false if the image is dropped */
+  bool save(const char * filename, const cv::Mat & img);
+  /**
+   * Show image in a window (from the background thread).
+   * \param window is the window name.
+   * \param img is the image - it is copied.
+   * \returns false if the image is dropped */
+  bool show(const char * window, const cv::Mat & img);
+  /**
+   * Finish all pending images and stop thread */
+  void stop();
+  /**
+   * Print number of saved, shown and dropped images */
+  void printStats();
+  
+private:
+  /// start writer thread if needed, must be called with queueLock locked
+  void startWriter();
+  /// show the latest image in windows with a pending image
+  bool showWindows();
+  static const int MAX_SLOTS = 4;
+  static const int MAX_WINDOWS = 8;
+  static const int MNL = 100;
+  /**
+   * One pending image to save */
+  class USlot
+  {
+  public:
+    bool used = false;
+    char name[MNL];
+    cv::Mat img;
+  };
+  USlot slots[MAX_SLOTS];
+  /**
+   * Latest image for one window */
+  class UWindow
+  {
+  public:
+    /// window name, empty if not used
+    char name[MNL] = "";
+    cv::Mat img;
+    /// a new image is waiting to be shown
+    bool pending = false;
+    /// image is being copied in or shown
+    bool busy = false;
+    int shownCnt = 0;
+    int droppedCnt = 0;
+  };
+  UWindow windows[MAX_WINDOWS];
+  /// order of used slots (ring buffer of slot index)
+  int queue[MAX_SLOTS];
+  int queueHead = 0;
+  int queueCnt = 0;
+  mutex queueLock;
+  //
+  thread * writer = nullptr;
+  static void startloop(UImageSink * sink); /// To spawn the writer loop as a separate thread, it needs to be static
+  void loop(); /// save or show queued images
+  bool terminate = false;
+  bool windowsOpen = false;
+  // statistics
+  int savedCnt = 0;
+  int shownCnt = 0;
+  int droppedCnt = 0;
+};
+
+/**
+ * Make this visible to the rest of the software */
+extern UImageSink imageSink;
+
+#endif
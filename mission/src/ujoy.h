@@ -66,6 +66,9 @@ public:
    * \param n is axis number. First axis is called button 1 
    * \returns value of axis */
   bool axis(int n);
+  /**
+   * Is a gamepad connected (and has sent status) */
+  bool isAvailable() { return available; }
   
 private:
   // data storage for
@@ -0,0 +1,78 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#ifndef ULATEST_H
+#define ULATEST_H
+
+#include <atomic>
+
+/**
+ * Lock-free slot holding the newest value from one writer thread
+ * to one reader thread (a triple buffer).
+ * The writer never waits for the reader, and the reader
+ * always gets the newest complete value - older values are dropped.
+ * \method publish(value)  from the writer thread only.
+ * \method get(value)  from the reader thread only.
+ * */
+template <class T>
+class ULatest
+{
+public:
+  /**
+   * Make this value the newest (writer thread only) */
+  void publish(const T & value)
+  {
+    slot[back] = value;
+    // swap the written slot with the middle slot and mark it as fresh
+    int old = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+    back = old & INDEX;
+  }
+  /**
+   * Get the newest value (reader thread only).
+   * \param value is set to the newest published value (or the default value if nothing is published).
+   * \returns true if the value is new since last call */
+  bool get(T & value)
+  {
+    bool fresh = (middle.load(std::memory_order_acquire) & FRESH) != 0;
+    if (fresh)
+    { // take the middle slot, and leave the old front slot for the writer
+      int old = middle.exchange(front, std::memory_order_acq_rel);
+      front = old & INDEX;
+    }
+    value = slot[front];
+    return fresh;
+  }
+  
+private:
+  static const int INDEX = 3;
+  static const int FRESH = 4;
+  T slot[3];
+  /// slot owned by the writer
+  int back = 0;
+  /// slot owned by the reader
+  int front = 1;
+  /// slot in transit, with the FRESH bit set when not yet read
+  std::atomic<int> middle{2};
+};
+
+#endif
@@ -0,0 +1,167 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, 
+ * Author:
+ * Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+#include <math.h>
+#include <opencv2/imgproc.hpp>
+#include "ulinedetect.h"
+
+
+void ULineDetect::reset()
+{
+  lastValid = false;
+  wasCrossing = false;
+}
+
+bool ULineDetect::detect(const cv::Mat & frame, const cv::Mat2f & floorMap, ULineResult & r)
+{
+  UTime t;
+  t.now();
+  int h = frame.rows;
+  int sw = frame.cols / scale;
+  gray.create(ROWS, sw, CV_8UC1);
+  mask.create(ROWS, sw, CV_8UC1);
+  int rowCnt = 0;
+  int crossCnt = 0;
+  int nearest = -1;
+  int farthest = -1;
+  float crossDist = 1e6;
+  for (int k = 0; k < ROWS; k++)
+  { // average a band of 'scale' image rows into one downscaled row
+    int row = int(h * (rowTop + (rowBottom - rowTop) * k / (ROWS - 1)));
+    int r1 = std::max(0, std::min(h - scale, row - scale / 2));
+    cv::resize(frame.rowRange(r1, r1 + scale), small, cv::Size(sw, 1), 0, 0, cv::INTER_AREA);
+    cv::Mat g = gray.row(k);
+    cv::cvtColor(small, g, cv::COLOR_BGR2GRAY);
+    findRuns(k, row, floorMap);
+    if (rowLine[k])
+    { // rows are from the top, so the last is the nearest
+      rowCnt++;
+      if (farthest < 0)
+        farthest = k;
+      nearest = k;
+    }
+    if (rowCrossing[k])
+    {
+      crossCnt++;
+      crossDist = std::min(crossDist, rowCrossingDist[k]);
+    }
+  }
+  r.lineRowCnt = rowCnt;
+  // a line in 3 rows or more is needed to be sure
+  r.lineValid = rowCnt >= 3;
+  if (r.lineValid)
+  {
+    r.lineOffset = rowLinePos[nearest][1];
+    r.lineDist = rowLinePos[nearest][0];
+    const cv::Vec2f & p1 = rowLinePos[nearest];
+    const cv::Vec2f & p2 = rowLinePos[farthest];
+    r.lineHeading = atan2f(p2[1] - p1[1], p2[0] - p1[0]);
+    lastOffset = r.lineOffset;
+  }
+  lastValid = r.lineValid;
+  // a crossing must be seen in 2 rows to remove noise
+  r.crossing = crossCnt >= 2;
+  if (r.crossing)
+  {
+    r.crossingDist = crossDist;
+    if (not wasCrossing)
+    { // new crossing event
+      crossingCnt++;
+      crossingTime = r.imageTime;
+    }
+  }
+  wasCrossing = r.crossing;
+  r.crossingCnt = crossingCnt;
+  r.crossingTime = crossingTime;
+  scanTime = t.getTimePassed();
+  return r.lineValid;
+}
+
+int ULineDetect::findRuns(int k, int row, const cv::Mat2f & floorMap)
+{
+  rowLine[k] = false;
+  rowCrossing[k] = false;
+  cv::Mat g = gray.row(k);
+  cv::Mat m = mask.row(k);
+  double minVal, maxVal;
+  cv::minMaxLoc(g, &minVal, &maxVal);
+  float avg = cv::mean(g)[0];
+  // threshold halfway from the floor (average) to the line
+  if (whiteLine)
+  {
+    if (maxVal - avg < minContrast)
+      return 0;
+    cv::compare(g, (avg + maxVal) / 2, m, cv::CMP_GT);
+  }
+  else
+  {
+    if (avg - minVal < minContrast)
+      return 0;
+    cv::compare(g, (avg + minVal) / 2, m, cv::CMP_LT);
+  }
+  // find runs in the thresholded row
+  const uint8_t * p = m.ptr<uint8_t>(0);
+  int n = m.cols;
+  int runCnt = 0;
+  float bestDist = 1e6;
+  int c = 0;
+  while (c < n)
+  {
+    if (p[c] == 0)
+    {
+      c++;
+      continue;
+    }
+    int c1 = c;
+    while (c < n and p[c] != 0)
+      c++;
+    runCnt++;
+    // run edges in full image, and on the floor
+    int x1 = c1 * scale;
+    int x2 = std::min(c * scale, floorMap.cols) - 1;
+    cv::Vec2f f1 = floorMap(row, x1);
+    cv::Vec2f f2 = floorMap(row, x2);
+    if (std::isnan(f1[0]) or std::isnan(f2[0]))
+      continue;
+    // run width across the robot (y is left)
+    float width = fabsf(f1[1] - f2[1]);
+    if (width >= crossingWidth)
+    {
+      rowCrossing[k] = true;
+      rowCrossingDist[k] = (f1[0] + f2[0]) / 2;
+    }
+    else if (width > lineWidth * 0.5 and width < lineWidth * 2.5)
+    { // a line, use the one closest to the line in last frame
+      cv::Vec2f ctr((f1[0] + f2[0]) / 2, (f1[1] + f2[1]) / 2);
+      float d = fabsf(ctr[1] - (lastValid ? lastOffset : 0));
+      if (d < bestDist)
+      {
+        bestDist = d;
+        rowLine[k] = true;
+        rowLinePos[k] = ctr;
+      }
+    }
+  }
+  return runCnt;
+}
@@ -0,0 +1,120 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#ifndef ULINEDETECT_H
+#define ULINEDETECT_H
+
+#include <opencv2/core.hpp>
+#include "utime.h"
+
+using namespace std;
+
+/**
+ * Line and crossing line seen in one image frame */
+class ULineResult
+{
+public:
+  /// serial number of the frame (from the capture loop)
+  int frameSerial = -1;
+  /// time the frame was captured
+  UTime imageTime;
+  /// line is found in enough scan rows
+  bool lineValid = false;
+  /// line position (y, left) in robot coordinates at the nearest scan row (meters)
+  float lineOffset = 0;
+  /// distance (x, forward) to the nearest scan row with line (meters)
+  float lineDist = 0;
+  /// line direction relative to robot heading (radians, left is positive)
+  float lineHeading = 0;
+  /// number of scan rows with line
+  int lineRowCnt = 0;
+  /// a crossing line is in view
+  bool crossing = false;
+  /// distance (x, forward) to the crossing line (meters)
+  float crossingDist = 0;
+  /// number of crossing events since start, and time of last event
+  int crossingCnt = 0;
+  UTime crossingTime;
+};
+
+/**
+ * Find a tape line and crossing lines on the floor from a few
+ * downscaled scan rows near the bottom of the image.
+ * The rows are made by averaging (cv::resize) and thresholded with
+ * vectorized (SIMD) OpenCV functions, so that only the
+ * line edges are handled one pixel at a time.
+ * The floor map (from UVision) converts pixel positions to robot coordinates. */
+class ULineDetect
+{
+public:
+  /**
+   * Find line and crossing in a frame.
+   * \param frame is the full BGR image.
+   * \param floorMap is floor position (x,y) in robot coordinates for each pixel in frame.
+   * \param r is set to the result (frameSerial and imageTime must be set in advance).
+   * \returns true if a line is found */
+  bool detect(const cv::Mat & frame, const cv::Mat2f & floorMap, ULineResult & r);
+  /**
+   * forget line position and crossing state */
+  void reset();
+  /// line is brighter than the floor (else darker)
+  bool whiteLine = true;
+  /// tape width (meters)
+  float lineWidth = 0.02;
+  /// minimum width of a crossing line (meters)
+  float crossingWidth = 0.15;
+  /// minimum brightness difference from line to floor
+  int minContrast = 30;
+  /// number of scan rows and their position (fraction of image height)
+  static const int ROWS = 8;
+  float rowTop = 0.70;
+  float rowBottom = 0.97;
+  /// downscale factor (pixels averaged in each direction)
+  int scale = 4;
+  /// time used for last frame (seconds)
+  float scanTime = 0;
+  
+private:
+  /**
+   * Find bright (or dark) runs in one scan row
+   * \returns number of runs */
+  int findRuns(int k, int row, const cv::Mat2f & floorMap);
+  /// scan rows (downscaled) in colour, gray and thresholded
+  cv::Mat small;
+  cv::Mat gray;
+  cv::Mat mask;
+  /// line and crossing found in each scan row
+  bool rowLine[ROWS];
+  cv::Vec2f rowLinePos[ROWS];
+  bool rowCrossing[ROWS];
+  float rowCrossingDist[ROWS];
+  /// line position in last frame
+  bool lastValid = false;
+  float lastOffset = 0;
+  /// crossing state and events
+  bool wasCrossing = false;
+  int crossingCnt = 0;
+  UTime crossingTime;
+};
+
+#endif
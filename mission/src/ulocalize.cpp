@@ -0,0 +1,244 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, 
+ * Author:
+ * Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include "ulocalize.h"
+
+// create value
+ULocalize localize;
+
+/// limit angle to [-pi..pi]
+static float limitPi(float a)
+{
+  while (a > M_PI)
+    a -= 2 * M_PI;
+  while (a < -M_PI)
+    a += 2 * M_PI;
+  return a;
+}
+
+bool ULocalize::setup(int argc, char **argv)
+{
+  const char * file = nullptr;
+  for (int i = 1; i < argc; i++)
+  { // check for command line parameters
+    if (strncmp(argv[i], "landmarks=", 10) == 0)
+      file = &argv[i][10];
+  }
+  if (file == nullptr)
+  { // default file, in this or the parent directory (from build)
+    file = "landmarks.txt";
+    if (access(file, R_OK) != 0)
+      file = "../landmarks.txt";
+  }
+  enabled = load(file) > 0;
+  return enabled;
+}
+
+int ULocalize::load(const char * file)
+{
+  FILE * f = fopen(file, "r");
+  if (f == nullptr)
+  {
+    printf("# ULocalize:: no landmark file '%s', using odometry only\n", file);
+    return 0;
+  }
+  landmarks.clear();
+  int lineNumber = 0;
+  const int MLL = 200;
+  char line[MLL];
+  while (fgets(line, MLL, f) != nullptr)
+  {
+    lineNumber++;
+    char * p1 = strchr(line, '#');
+    if (p1 != nullptr)
+      *p1 = '\0';
+    p1 = line;
+    while (*p1 == ' ' or *p1 == '\t')
+      p1++;
+    p1[strcspn(p1, "\r\n")] = '\0';
+    if (*p1 == '\0')
+      continue;
+    ULandmark l;
+    float hdeg;
+    if (sscanf(p1, "marker %d %f %f %f", &l.id, &l.x, &l.y, &hdeg) == 4)
+    {
+      l.h = hdeg * M_PI / 180;
+      landmarks.push_back(l);
+    }
+    else
+      printf("# %s:%d: not a landmark '%s'\n", file, lineNumber, p1);
+  }
+  fclose(f);
+  printf("# ULocalize:: loaded %d landmarks from '%s'\n", (int)landmarks.size(), file);
+  return landmarks.size();
+}
+
+void ULocalize::onPose(float x, float y, float h)
+{
+  dataLock.lock();
+  if (histCnt > 0)
+  { // odometry drift makes the correction less certain
+    const UOdoPose & last = hist[(histNext + MAX_HIST - 1) % MAX_HIST];
+    float d = hypotf(x - last.x, y - last.y);
+    distSinceFix += d;
+    varPos += driftPos * d;
+    varHeading += driftHeading * d;
+  }
+  UOdoPose & p = hist[histNext];
+  p.t.now();
+  p.x = x;
+  p.y = y;
+  p.h = h;
+  histNext = (histNext + 1) % MAX_HIST;
+  if (histCnt < MAX_HIST)
+    histCnt++;
+  dataLock.unlock();
+}
+
+bool ULocalize::odoAt(UTime t, UOdoPose & p)
+{ // newest pose that is not after t
+  for (int i = 1; i <= histCnt; i++)
+  {
+    UOdoPose & h = hist[(histNext + MAX_HIST - i) % MAX_HIST];
+    if (not (h.t > t) or i == histCnt)
+    {
+      p = h;
+      // no usable pose, if more than 0.1 s from image time
+      return fabs(t - h.t) < 0.1;
+    }
+  }
+  return false;
+}
+
+void ULocalize::onMarkers(const UArucoResult & r)
+{
+  if (not enabled or r.markerCnt == 0)
+    return;
+  dataLock.lock();
+  UOdoPose o;
+  if (odoAt(r.imageTime, o))
+  {
+    for (int i = 0; i < r.markerCnt; i++)
+    {
+      const UArucoMarker & m = r.marker[i];
+      for (const ULandmark & l : landmarks)
+      {
+        if (l.id == m.id)
+          fix(l, m, o);
+      }
+    }
+  }
+  dataLock.unlock();
+}
+
+void ULocalize::fix(const ULandmark & l, const UArucoMarker & m, const UOdoPose & o)
+{ // robot pose in map from the marker
+  // marker heading is relative to robot, so robot heading in map is
+  float mh = limitPi(l.h - m.heading);
+  float mx = l.x - (cosf(mh) * m.pos[0] - sinf(mh) * m.pos[1]);
+  float my = l.y - (sinf(mh) * m.pos[0] + cosf(mh) * m.pos[1]);
+  // measurement uncertainty grows with marker distance
+  float sd = posNoise + posNoisePerM * m.dist;
+  float varM = sd * sd;
+  float varMh = headingNoise * headingNoise * (1 + m.dist * m.dist);
+  // innovation, compared with the corrected odometry pose
+  float eh = limitPi(mh - (o.h + ch));
+  float px = cosf(ch) * o.x - sinf(ch) * o.y + cx;
+  float py = sinf(ch) * o.x + cosf(ch) * o.y + cy;
+  float e = hypotf(mx - px, my - py);
+  if (e > 3 * sqrtf(varPos + varM) and fixCnt > 0)
+  { // outlier (wrong marker ID or bad pose estimate)
+    rejectCnt++;
+    return;
+  }
+  // heading first, the rotation is about the robot, so the
+  // offset is changed to keep the robot map position (px, py)
+  float kh = varHeading / (varHeading + varMh);
+  ch = limitPi(ch + kh * eh);
+  varHeading *= 1 - kh;
+  cx = px - (cosf(ch) * o.x - sinf(ch) * o.y);
+  cy = py - (sinf(ch) * o.x + cosf(ch) * o.y);
+  // then position
+  float k = varPos / (varPos + varM);
+  cx += k * (mx - px);
+  cy += k * (my - py);
+  varPos *= 1 - k;
+  // the fix is at image time, the distance after that is in the history
+  distSinceFix = 0;
+  for (int i = 1; i <= histCnt; i++)
+  {
+    UOdoPose & a = hist[(histNext + MAX_HIST - i) % MAX_HIST];
+    const UOdoPose & b = hist[(histNext + MAX_HIST - i - 1) % MAX_HIST];
+    if (not (a.t > o.t) or i == histCnt)
+      break;
+    distSinceFix += hypotf(a.x - b.x, a.y - b.y);
+  }
+  fixCnt++;
+  sumInnovation += e;
+  lastFix.now();
+}
+
+void ULocalize::getPose(float & x, float & y, float & h)
+{
+  dataLock.lock();
+  if (histCnt > 0)
+  {
+    const UOdoPose & o = hist[(histNext + MAX_HIST - 1) % MAX_HIST];
+    x = cosf(ch) * o.x - sinf(ch) * o.y + cx;
+    y = sinf(ch) * o.x + cosf(ch) * o.y + cy;
+    h = limitPi(o.h + ch);
+  }
+  else
+  {
+    x = 0;
+    y = 0;
+    h = 0;
+  }
+  dataLock.unlock();
+}
+
+bool ULocalize::isValid(float maxDist, float maxStd)
+{
+  dataLock.lock();
+  bool valid = fixCnt > 0 and distSinceFix < maxDist and varPos < maxStd * maxStd;
+  dataLock.unlock();
+  return valid;
+}
+
+void ULocalize::report()
+{
+  if (not enabled)
+    return;
+  dataLock.lock();
+  printf("# ULocalize:: %d fixes (%d rejected), mean innovation %.3f m\n", 
+         fixCnt, rejectCnt, fixCnt > 0 ? sumInnovation / fixCnt : 0);
+  printf("# ULocalize:: correction (%.3f, %.3f) m, %.1f deg, std %.3f m, %.1f deg\n", 
+         cx, cy, ch * 180 / M_PI, sqrtf(varPos), sqrtf(varHeading) * 180 / M_PI);
+  dataLock.unlock();
+}
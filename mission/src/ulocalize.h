@@ -0,0 +1,129 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+#ifndef ULOCALIZE_H
+#define ULOCALIZE_H
+
+#include <vector>
+#include <mutex>
+#include "utime.h"
+#include "uaruco.h"
+
+using namespace std;
+
+/**
+ * Localization in map coordinates from odometry and landmark fixes.
+ * The landmarks are ArUco markers with a known map position and direction,
+ * loaded from 'landmarks.txt' (or 'landmarks=file'), lines are
+ * 'marker ID x y heading' (m and degrees, heading is the marker front direction).
+ * A marker seen by the camera gives the robot pose in the map, this is
+ * compared with the odometry pose at the image time, and the odometry to
+ * map correction is updated (a small Kalman filter for position and heading).
+ * The correction uncertainty grows with distance driven, so the correction
+ * follows the odometry drift on the fly, and 'isValid()' tells if there
+ * is a recent fix, e.g. to skip a drive-to-post calibration manoeuvre. */
+class ULocalize
+{
+public:
+  /**
+   * Load landmarks
+   * \returns true if there are landmarks to use */
+  bool setup(int argc, char **argv);
+  /**
+   * New odometry pose (from UPose)
+   * \param x,y,h is the pose in odometry coordinates */
+  void onPose(float x, float y, float h);
+  /**
+   * New markers found (from UVision) */
+  void onMarkers(const UArucoResult & r);
+  /**
+   * Robot pose now in map coordinates (odometry pose if no fix) */
+  void getPose(float & x, float & y, float & h);
+  /**
+   * Is there a recent fix
+   * \param maxDist is the maximum distance driven since last fix (m)
+   * \param maxStd is the maximum position uncertainty (m)
+   * \returns true if the map pose is that good */
+  bool isValid(float maxDist = 0.5, float maxStd = 0.05);
+  /**
+   * Print fix statistics */
+  void report();
+  /// landmarks are loaded, and markers are used
+  bool enabled = false;
+  /// marker heading is less precise than position (scale of measurement std)
+  float headingNoise = 0.05;
+  /// position measurement std at 0 m and per meter marker distance
+  float posNoise = 0.02;
+  float posNoisePerM = 0.03;
+  /// odometry drift variance per meter driven (m^2 and rad^2)
+  float driftPos = 0.02 * 0.02;
+  float driftHeading = 0.02 * 0.02;
+
+private:
+  /**
+   * A landmark with known map pose */
+  class ULandmark
+  {
+  public:
+    int id;
+    float x, y, h;
+  };
+  /**
+   * Odometry pose with the time it was received */
+  class UOdoPose
+  {
+  public:
+    UTime t;
+    float x, y, h;
+  };
+  /// load landmark file, returns number of landmarks
+  int load(const char * file);
+  /// odometry pose at this time (nearest in history), false if too old
+  bool odoAt(UTime t, UOdoPose & p);
+  /// use one marker as a fix
+  void fix(const ULandmark & l, const UArucoMarker & m, const UOdoPose & o);
+  vector<ULandmark> landmarks;
+  /// recent odometry poses (ring buffer)
+  static const int MAX_HIST = 200;
+  UOdoPose hist[MAX_HIST];
+  int histCnt = 0;
+  int histNext = 0;
+  /// odometry to map correction: map = rotate(ch) * odo + (cx, cy)
+  float cx = 0, cy = 0, ch = 0;
+  /// correction variance (position m^2, heading rad^2)
+  float varPos = 1.0;
+  float varHeading = 0.3;
+  /// distance driven since last fix
+  float distSinceFix = 1e6;
+  /// fix statistics
+  int fixCnt = 0;
+  int rejectCnt = 0;
+  float sumInnovation = 0;
+  UTime lastFix;
+  mutex dataLock;
+};
+
+/**
+ * Make this visible to the rest of the software */
+extern ULocalize localize;
+
+#endif
@@ -0,0 +1,475 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, 
+ * Author:
+ * Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <unistd.h>
+#include "umission.h"
+#include "ubridge.h"
+#include "uevent.h"
+#include "utime.h"
+#include "uprofiler.h"
+
+// create value
+UMission mission;
+
+/// names that may be assigned in a mission line (before ':')
+static const char * assignNames[] = {"vel", "acc", "tr", "edgel", "edger", "white", 
+  "wall", "irsensor", "irdist", "log", "bal", "head", "servo", "pservo", "vservo", 
+  "label", "goto", "event", "topos", "drive", nullptr};
+/// names that may be tested in a mission line (after ':')
+static const char * conditionNames[] = {"dist", "turn", "time", "count", "xl", "xb", 
+  "lv", "ir1", "ir2", "tilt", "event", "head", "last", "vel", "pos", "abs", 
+  "reason", "log", nullptr};
+
+
+bool UMission::setup(int argc, char **argv)
+{
+  const char * file = nullptr;
+  for (int i = 1; i < argc; i++)
+  { // check for command line parameters
+    if (strncmp(argv[i], "missions=", 9) == 0)
+      file = &argv[i][9];
+  }
+  if (file == nullptr)
+  { // default file, in this or the parent directory (from build)
+    file = "missions.txt";
+    if (access(file, R_OK) != 0)
+      file = "../missions.txt";
+  }
+  int errors = load(file);
+  if (errors == 0)
+    print();
+  return errors == 0 and missions.size() > 0;
+}/**
+ * Valid value range for a condition, to catch unit errors,
+ * e.g. an IR distance in cm in place of meters */
+class UValueRange
+{
+public:
+  const char * name;
+  float min, max;
+};
+static const UValueRange conditionRanges[] = {
+  {"dist", -20, 20},   // meter
+  {"turn", -720, 720}, // degrees
+  {"time", 0, 600},    // seconds
+  {"count", 0, 1000},
+  {"xl", 0, 20},       // line sensor values
+  {"xb", 0, 20},
+  {"lv", 0, 20},
+  {"ir1", 0, 1.5},     // meter
+  {"ir2", 0, 1.5},
+  {"tilt", -1.6, 1.6}, // radians
+  {"event", 0, 32},
+  {"vel", -3, 3},      // m/s
+  {nullptr, 0, 0}};
+
+/**
+ * Test a comma separated list of 'name=value' or 'name<value' items.
+ * Condition values are tested against conditionRanges too.
+ * \returns true if all names are known and all values are numbers */
+static bool checkList(char * s, const char ** names, bool condition, char * why, int whyCnt)
+{
+  char * save = nullptr;
+  char * item = strtok_r(s, ",", &save);
+  while (item != nullptr)
+  {
+    while (*item == ' ' or *item == '\t')
+      item++;
+    // name
+    char * p1 = item;
+    while (isalnum(*p1))
+      p1++;
+    int n = p1 - item;
+    bool known = false;
+    for (int i = 0; names[i] != nullptr and not known; i++)
+      known = n > 0 and (int)strlen(names[i]) == n and strncmp(names[i], item, n) == 0;
+    if (not known)
+    {
+      snprintf(why, whyCnt, "unknown %s '%.*s'", condition ? "condition" : "assignment", n, item);
+      return false;
+    }
+    // operator
+    while (*p1 == ' ')
+      p1++;
+    if (*p1 == '=')
+      p1++;
+    else if (condition and (*p1 == '<' or *p1 == '>'))
+    {
+      p1++;
+      if (*p1 == '=')
+        p1++;
+    }
+    else
+    {
+      snprintf(why, whyCnt, "missing %s after '%.*s'", condition ? "'=', '<' or '>'" : "'='", n, item);
+      return false;
+    }
+    // value
+    char * p2;
+    float v = strtof(p1, &p2);
+    while (*p2 == ' ' or *p2 == '\t' or *p2 == '\r')
+      p2++;
+    if (p2 == p1 or *p2 != '\0')
+    {
+      snprintf(why, whyCnt, "value for '%.*s' is not a number", n, item);
+      return false;
+    }
+    for (int i = 0; condition and conditionRanges[i].name != nullptr; i++)
+    {
+      const UValueRange & r = conditionRanges[i];
+      if ((int)strlen(r.name) == n and strncmp(r.name, item, n) == 0 and (v < r.min or v > r.max))
+      {
+        snprintf(why, whyCnt, "value %g for '%.*s' is outside %g..%g", v, n, item, r.min, r.max);
+        return false;
+      }
+    }
+    item = strtok_r(nullptr, ",", &save);
+  }
+  return true;
+}
+
+bool UMission::checkLine(const char * line, char * why)
+{
+  const int MLL = 500;
+  char s[MLL];
+  strncpy(s, line, MLL - 1);
+  s[MLL - 1] = '\0';
+  char * colon = strchr(s, ':');
+  if (colon != nullptr)
+  { // split in assignment and condition part
+    *colon = '\0';
+    if (strchr(colon + 1, ':') != nullptr)
+    {
+      snprintf(why, MWL, "more than one ':'");
+      return false;
+    }
+  }
+  if (not checkList(s, assignNames, false, why, MWL))
+    return false;
+  if (colon != nullptr and not checkList(colon + 1, conditionNames, true, why, MWL))
+    return false;
+  return true;
+}
+
+/**
+ * Find the value of an item like 'name=value' or 'name<value'
+ * \returns position of the value in the line, or string::npos */
+static size_t valuePosition(const string & line, const char * name)
+{
+  size_t n = strlen(name);
+  size_t p = 0;
+  while ((p = line.find(name, p)) != string::npos)
+  {
+    size_t e = p + n;
+    bool start = p == 0 or line[p - 1] == ',' or line[p - 1] == ':' or isspace(line[p - 1]);
+    while (e < line.size() and isspace(line[e]))
+      e++;
+    if (start and e < line.size() and strchr("=<>", line[e]) != nullptr)
+    { // skip operator
+      e++;
+      if (e < line.size() and line[e] == '=')
+        e++;
+      return e;
+    }
+    p = e;
+  }
+  return string::npos;
+}
+
+bool UMission::setValue(string & line, const char * name, float value)
+{
+  size_t e = valuePosition(line, name);
+  if (e == string::npos)
+    return false;
+  // replace the number
+  const char * p1 = line.c_str() + e;
+  char * p2;
+  strtof(p1, &p2);
+  const int MVL = 30;
+  char s[MVL];
+  snprintf(s, MVL, "%g", value);
+  line.replace(e, p2 - p1, s);
+  return true;
+}
+
+bool UMission::getValue(const string & line, const char * name, float & value)
+{
+  size_t e = valuePosition(line, name);
+  if (e == string::npos)
+    return false;
+  value = strtof(line.c_str() + e, nullptr);
+  return true;
+}
+
+bool UMission::setLineValue(const char * mission, int line, const char * name, float value)
+{
+  UMissionScript * m = find(mission);
+  if (m == nullptr or line < 0 or line >= (int)m->lines.size())
+    return false;
+  if (not setValue(m->lines[line], name, value))
+    return false;
+  compile(*m);
+  return true;
+}
+
+int UMission::load(const char * file)
+{
+  UTime t;
+  t.now();
+  FILE * f = fopen(file, "r");
+  if (f == nullptr)
+  {
+    printf("# UMission:: failed to open mission file '%s'\n", file);
+    return 1;
+  }
+  strncpy(filename, file, MFL - 1);
+  missions.clear();
+  int errors = 0;
+  int lineNumber = 0;
+  const int MLL = 500;
+  char line[MLL];
+  while (fgets(line, MLL, f) != nullptr)
+  {
+    lineNumber++;
+    // remove comment and trailing white space
+    char * p1 = strchr(line, '#');
+    if (p1 != nullptr)
+      *p1 = '\0';
+    int n = strlen(line);
+    while (n > 0 and isspace(line[n - 1]))
+      line[--n] = '\0';
+    p1 = line;
+    while (isspace(*p1))
+      p1++;
+    if (*p1 == '\0')
+      continue;
+    if (*p1 == '[')
+    { // new mission
+      char * p2 = strchr(p1, ']');
+      if (p2 == nullptr or p2 == p1 + 1)
+      {
+        printf("# %s:%d: bad mission name '%s'\n", file, lineNumber, p1);
+        errors++;
+        continue;
+      }
+      *p2 = '\0';
+      if (find(p1 + 1) != nullptr)
+      {
+        printf("# %s:%d: mission '%s' is defined twice\n", file, lineNumber, p1 + 1);
+        errors++;
+      }
+      missions.emplace_back();
+      missions.back().name = p1 + 1;
+      continue;
+    }
+    if (missions.empty())
+    {
+      printf("# %s:%d: line before first [mission] name\n", file, lineNumber);
+      errors++;
+      continue;
+    }
+    char why[MWL];
+    if (not checkLine(p1, why))
+    {
+      printf("# %s:%d: %s in '%s'\n", file, lineNumber, why, p1);
+      errors++;
+      continue;
+    }
+    missions.back().lines.push_back(p1);
+    missions.back().fileLine.push_back(lineNumber);
+  }
+  fclose(f);
+  for (UMissionScript & m : missions)
+  {
+    if (m.lines.empty())
+    { // a misspelled or unfinished section
+      printf("# %s: mission '%s' has no lines\n", file, m.name.c_str());
+      errors++;
+    }
+    compile(m);
+  }
+  startBurst.clear();
+  UBridge::frameLine("regbot start", startBurst);
+  printf("# UMission:: loaded %d missions from '%s' in %.2f ms, %d errors\n", 
+         (int)missions.size(), file, t.getTimePassed() * 1000, errors);
+  return errors;
+}
+
+void UMission::addSegments(UMissionScript & m)
+{ // find events used by the mission
+  bool used[33] = {false};
+  for (const string & s : m.lines)
+  {
+    const char * p1 = strstr(s.c_str(), "event");
+    while (p1 != nullptr)
+    {
+      p1 += 5;
+      while (*p1 != '\0' and not isdigit(*p1))
+        p1++;
+      int e = strtol(p1, nullptr, 10);
+      if (e >= 0 and e < 33)
+        used[e] = true;
+      p1 = strstr(p1, "event");
+    }
+  }
+  vector<int> free;
+  for (int e = 1; e < 33; e++)
+  {
+    if (not used[e])
+      free.push_back(e);
+  }
+  m.segLine.clear();
+  m.segEvent.clear();
+  int n = m.lines.size();
+  if (free.empty() or n == 0)
+    return;
+  // lines in each segment, if not enough free events
+  int group = (n + free.size() - 1) / free.size();
+  for (int i = 0; i < n; i += group)
+  {
+    m.segLine.push_back(i);
+    m.segEvent.push_back(free[i / group]);
+  }
+}
+
+void UMission::compile(UMissionScript & m)
+{
+  m.burst.clear();
+  m.segLine.clear();
+  m.segEvent.clear();
+  if (profiler.enabled)
+    addSegments(m);
+  UBridge::frameLine("regbot mclear", m.burst);
+  int seg = 0;
+  for (int i = 0; i < (int)m.lines.size(); i++)
+  {
+    string line = "regbot madd ";
+    if (seg < (int)m.segLine.size() and m.segLine[seg] == i)
+    { // mark start of segment with an event
+      line += "event=" + to_string(m.segEvent[seg]);
+      if (m.lines[i][0] != ':')
+        line += ",";
+      seg++;
+    }
+    line += m.lines[i];
+    UBridge::frameLine(line.c_str(), m.burst);
+  }
+}
+
+UMission::UMissionScript * UMission::find(const char * name)
+{
+  for (UMissionScript & m : missions)
+  {
+    if (m.name == name)
+      return &m;
+  }
+  return nullptr;
+}
+
+const vector<string> * UMission::getLines(const char * name)
+{
+  UMissionScript * m = find(name);
+  if (m == nullptr)
+    return nullptr;
+  return &m->lines;
+}
+
+bool UMission::upload(const char * name, bool start)
+{
+  UMissionScript * m = find(name);
+  if (m == nullptr)
+  {
+    printf("# UMission:: no mission '%s' in '%s'\n", name, filename);
+    return false;
+  }
+  UTime t;
+  t.now();
+  // clear events received from last mission
+  event.clearEvents();
+  profiler.missionSent(m->name, m->lines, m->fileLine, m->segLine, m->segEvent);
+  int n = bridge.txFramed(m->burst);
+  if (n >= 0 and start)
+  {
+    int n2 = bridge.txFramed(startBurst);
+    n = (n2 < 0) ? n2 : n + n2;
+  }
+  if (n < 0)
+  {
+    printf("# UMission:: failed to send mission '%s'\n", name);
+    return false;
+  }
+  printf("# UMission:: mission '%s' %d lines (%d bytes) uploaded in %.2f ms\n", 
+         name, (int)m->lines.size(), n, t.getTimePassed() * 1000);
+  return true;
+}
+
+bool UMission::stage(const char * name)
+{
+  UMissionScript * m = find(name);
+  if (m == nullptr)
+  {
+    printf("# UMission:: no mission '%s' in '%s' to stage\n", name, filename);
+    staged.name.clear();
+    return false;
+  }
+  staged.name = m->name;
+  staged.lines = m->lines;
+  staged.fileLine = m->fileLine;
+  staged.segLine = m->segLine;
+  staged.segEvent = m->segEvent;
+  staged.burst = m->burst + startBurst;
+  return true;
+}
+
+bool UMission::sendStaged()
+{
+  if (staged.name.empty())
+    return false;
+  UTime t;
+  t.now();
+  event.clearEvents();
+  profiler.missionSent(staged.name, staged.lines, staged.fileLine, staged.segLine, staged.segEvent);
+  int n = bridge.txFramed(staged.burst);
+  if (n < 0)
+  {
+    printf("# UMission:: failed to send staged mission '%s'\n", staged.name.c_str());
+    staged.name.clear();
+    return false;
+  }
+  printf("# UMission:: staged mission '%s' %d lines (%d bytes) sent in %.2f ms\n", 
+         staged.name.c_str(), (int)staged.lines.size(), n, t.getTimePassed() * 1000);
+  staged.name.clear();
+  return true;
+}
+
+void UMission::print()
+{
+  for (const UMissionScript & m : missions)
+    printf("# mission '%s' has %d lines (%d bytes)\n", 
+           m.name.c_str(), (int)m.lines.size(), (int)m.burst.size());
+}
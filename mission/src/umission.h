@@ -0,0 +1,150 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#ifndef UMISSION_H
+#define UMISSION_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Mission scripts for the regbot, loaded from a text file.
+ * The file has a section for each mission (challenge), like
+ *   [seesaw]
+ *   vel=0.25,edgel=2:xl > 16
+ *   vel=0.1:dist=0.1
+ * where each line is a 'regbot madd' line and '#' starts a comment.
+ * All lines are checked when loaded, and each mission is made
+ * ready for upload (with CRC) as one burst of data. */
+class UMission
+{
+public:
+  /**
+   * Load missions from file given as 'missions=file' on the command line,
+   * default is 'missions.txt' (or '../missions.txt' from a build directory).
+   * \returns false if the file is not found or has errors */
+  bool setup(int argc, char **argv);
+  /**
+   * Load, check and prepare all missions in a file.
+   * Any already loaded missions are replaced.
+   * \returns number of errors found */
+  int load(const char * filename);
+  /**
+   * Upload a mission to the robot as one burst,
+   * any old mission is removed (mclear) and events are cleared.
+   * \param name is the mission name (section in the file)
+   * \param start if true, the mission is started too
+   * \returns false if the mission is not found */
+  bool upload(const char * name, bool start = false);
+  /**
+   * Prepare a mission (and start) as one block of data,
+   * so that it can be sent with one write when needed.
+   * \param name is the mission name
+   * \returns false if the mission is not found */
+  bool stage(const char * name);
+  /**
+   * Send the staged mission (mclear, lines and start) in one write.
+   * Events are cleared just before.
+   * \returns false if nothing is staged */
+  bool sendStaged();
+  /**
+   * Name of staged mission (empty if none) */
+  const char * stagedName()
+  {
+    return staged.name.c_str();
+  }
+  /**
+   * Get the lines of a mission
+   * \returns nullptr if not found */
+  const vector<string> * getLines(const char * name);
+  /**
+   * Print loaded missions with number of lines and size */
+  void print();
+  /**
+   * Test if a mission line has valid syntax and known names
+   * \param line is the mission line (without 'regbot madd')
+   * \param why is set to the reason if not valid (of size MWL)
+   * \returns true if valid */
+  static bool checkLine(const char * line, char * why);
+  /**
+   * Change a value in a mission line, e.g. 'dist' in 'vel=0.2:dist=0.5'
+   * \param line is the mission line to change
+   * \param name is the assignment or condition name
+   * \param value is the new value
+   * \returns false if the name is not in the line */
+  static bool setValue(string & line, const char * name, float value);
+  /**
+   * Get a value from a mission line, e.g. 'dist' in 'vel=0.2:dist=0.5'
+   * \param line is the mission line (or a part of it)
+   * \param name is the assignment or condition name
+   * \param value is set to the value, if found
+   * \returns false if the name is not in the line */
+  static bool getValue(const string & line, const char * name, float & value);
+  /**
+   * Change a value in a line of a loaded mission (see setValue),
+   * the mission is compiled again (stage it again if staged)
+   * \param mission is the mission name
+   * \param line is the line index in the mission
+   * \returns false if the mission, the line or the name is not found */
+  bool setLineValue(const char * mission, int line, const char * name, float value);
+  static const int MWL = 100;
+  
+private:
+  /**
+   * One mission (section in the file) */
+  class UMissionScript
+  {
+  public:
+    string name;
+    /// mission lines
+    vector<string> lines;
+    /// line number in file for each line
+    vector<int> fileLine;
+    /// 'mclear' and all lines with CRC, ready to send
+    string burst;
+    /// first line and marking event for each segment (when profiling)
+    vector<int> segLine;
+    vector<int> segEvent;
+  };
+  /// find mission by name, nullptr if not found
+  UMissionScript * find(const char * name);
+  /// prepare mission for upload
+  void compile(UMissionScript & m);
+  /// split mission in segments, each marked with an unused event
+  void addSegments(UMissionScript & m);
+  vector<UMissionScript> missions;
+  /// 'start' with CRC
+  string startBurst;
+  /// mission ready to send with start (burst has both)
+  UMissionScript staged;
+  static const int MFL = 200;
+  char filename[MFL] = "";
+};
+
+/**
+ * Make this visible to the rest of the software */
+extern UMission mission;
+
+#endif
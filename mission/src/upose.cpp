@@ -26,6 +26,8 @@
 #include <string.h>
 #include "upose.h"
 #include "ubridge.h"
+#include "uprofiler.h"
+#include "ulocalize.h"
 
 // create value
 UPose pose;
@@ -51,13 +53,36 @@ bool UPose::decode(char* msg)
       return false;
     // get data
     dataLock.lock();
+    double t0 = t;
+    float x0 = x, y0 = y, h0 = h;
     // time in seconds
     t = strtof64(p1, (char**)&p1);
     x = strtof(p1, (char**)&p1); // x
     y = strtof(p1, (char**)&p1); // y
     h = strtof(p1, (char**)&p1); // heading (rad)
     tilt = strtof(p1, (char**)&p1); // tilt in radians around robot y-axis
+    float dt = t - t0;
+    if (dt > 0 and dt < 0.5)
+    { // velocity in heading direction
+      vel = ((x - x0) * cosf(h) + (y - y0) * sinf(h)) / dt;
+      float dh = h - h0;
+      if (dh > M_PI)
+        dh -= 2 * M_PI;
+      else if (dh < -M_PI)
+        dh += 2 * M_PI;
+      turnRate = dh / dt;
+    }
+    else
+    { // first pose (or old)
+      vel = 0;
+      turnRate = 0;
+    }
+    float px = x, py = y, ph = h;
+    if (logFile != nullptr)
+      fprintf(logFile, "%.4f %.4f %.4f %.4f %.4f\n", t, x, y, h, tilt);
     dataLock.unlock();
+    profiler.onPose(px, py);
+    localize.onPose(px, py, ph);
   }
   else
     used = false;
@@ -66,4 +91,32 @@ bool UPose::decode(char* msg)
   return used;
 }
 
+void UPose::openLog(const char * filename)
+{
+  dataLock.lock();
+  logFile = fopen(filename, "w");
+  if (logFile != nullptr)
+    fprintf(logFile, "%% pose log\n%% 1 time (sec)\n%% 2,3 x,y (m)\n%% 4 heading (rad)\n%% 5 tilt (rad)\n");
+  dataLock.unlock();
+  if (logFile == nullptr)
+    printf("# UPose:: failed to open pose log '%s'\n", filename);
+  else
+    printf("# UPose:: logging poses to '%s'\n", filename);
+}
 
+void UPose::logEvent(int e)
+{
+  dataLock.lock();
+  if (logFile != nullptr)
+    fprintf(logFile, "%% event %d at %.4f\n", e, t);
+  dataLock.unlock();
+}
+
+void UPose::closeLog()
+{
+  dataLock.lock();
+  if (logFile != nullptr)
+    fclose(logFile);
+  logFile = nullptr;
+  dataLock.unlock();
+}
@@ -37,6 +37,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <math.h>
+#include <stdio.h>
 
 using namespace std;
 // forward declaration
@@ -49,6 +50,17 @@ public:
   /** decode an unpacked incoming messages
    * \returns true if the message us used */
   bool decode(char * msg);
+  /**
+   * Save all poses (and events) to a file, for the speed profile tool.
+   * \param filename is the log file, lines are 'time x y h tilt',
+   * and '% event N' when an event is received */
+  void openLog(const char * filename);
+  /**
+   * Add event to the log (if open) */
+  void logEvent(int e);
+  /**
+   * Close pose log */
+  void closeLog();
 
 public:
   /// x (forward), y (left), h (heading) in odometry coordinates
@@ -58,6 +70,11 @@ public:
   /// pose time from hardware (Regbot) in seconds
   /// since start of hardware
   double t;
+  /// forward velocity (m/s) and turn rate (rad/s) from the last two poses
+  float vel = 0;
+  float turnRate = 0;
+  /// pose log (nullptr if not logging)
+  FILE * logFile = nullptr;
   
   mutex dataLock;
 };
@@ -0,0 +1,198 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, 
+ * Author:
+ * Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include "uprofiler.h"
+
+// create value
+UProfiler profiler;
+
+
+void UProfiler::setup(int argc, char **argv)
+{
+  for (int i = 1; i < argc; i++)
+  { // check for command line parameters
+    if (strcmp(argv[i], "profile") == 0)
+      enabled = true;
+  }
+  if (enabled)
+    printf("# UProfiler:: mission lines are marked with events for profiling\n");
+}
+
+void UProfiler::missionSent(const string & name, const vector<string> & lines, const vector<int> & fileLine, 
+                            const vector<int> & segLine, const vector<int> & segEvent)
+{
+  if (not enabled)
+    return;
+  dataLock.lock();
+  missions.emplace_back();
+  UMissionProfile & m = missions.back();
+  m.name = name;
+  m.sent.now();
+  for (int i = 0; i < 34; i++)
+    m.eventSeg[i] = -1;
+  for (int s = 0; s < (int)segLine.size(); s++)
+  {
+    USegment seg;
+    seg.line = segLine[s];
+    seg.fileLine = fileLine[seg.line];
+    if (s + 1 < (int)segLine.size())
+      seg.lineCnt = segLine[s + 1] - seg.line;
+    else
+      seg.lineCnt = lines.size() - seg.line;
+    seg.text = lines[seg.line];
+    m.segments.push_back(seg);
+    if (segEvent[s] > 0 and segEvent[s] < 33)
+      m.eventSeg[segEvent[s]] = s;
+  }
+  current = -1;
+  active = false;
+  dataLock.unlock();
+}
+
+void UProfiler::closeSegment(UMissionProfile & m, UTime t)
+{
+  if (current >= 0)
+    m.segments[current].time += t - segmentStart;
+  current = -1;
+}
+
+void UProfiler::onEvent(int e, UTime t)
+{
+  if (not enabled)
+    return;
+  dataLock.lock();
+  if (not missions.empty() and e >= 0 and e < 34)
+  {
+    UMissionProfile & m = missions.back();
+    if (e == 33)
+    { // mission started
+      m.started = t;
+      current = -1;
+      active = true;
+    }
+    else if (e == 0)
+    { // mission ended
+      closeSegment(m, t);
+      m.ended = t;
+      active = false;
+    }
+    else if (active and m.eventSeg[e] >= 0)
+    { // new segment
+      closeSegment(m, t);
+      current = m.eventSeg[e];
+      m.segments[current].entries++;
+      segmentStart = t;
+    }
+  }
+  dataLock.unlock();
+}
+
+void UProfiler::onPose(float x, float y)
+{
+  if (not enabled)
+    return;
+  dataLock.lock();
+  if (active and lastValid and not missions.empty())
+  {
+    float d = hypotf(x - lastX, y - lastY);
+    // a jump is an odometry reset, not a distance
+    if (d < 0.5)
+    {
+      UMissionProfile & m = missions.back();
+      m.dist += d;
+      if (current >= 0)
+        m.segments[current].dist += d;
+    }
+  }
+  lastX = x;
+  lastY = y;
+  lastValid = true;
+  dataLock.unlock();
+}
+
+void UProfiler::report()
+{
+  if (not enabled)
+    return;
+  const int MSL = 100;
+  char s[MSL];
+  char fn[MSL];
+  UTime t;
+  t.now();
+  snprintf(fn, MSL, "profile_%s.txt", t.getForFilename(s));
+  FILE * f = fopen(fn, "w");
+  if (f == nullptr)
+    printf("# UProfiler:: failed to open '%s'\n", fn);
+  dataLock.lock();
+  if (f != nullptr)
+  {
+    fprintf(f, "%% mission profile %s\n", t.getDateTimeAsString(s));
+    fprintf(f, "%% 1 mission name\n%% 2 segment\n%% 3 line number in mission file\n");
+    fprintf(f, "%% 4 number of mission lines in segment\n%% 5 entries (more if looping)\n");
+    fprintf(f, "%% 6 time (sec)\n%% 7 distance (m)\n%% 8 average velocity (m/s)\n%% 9 first mission line\n");
+  }
+  // all segments with time, for the slowest list
+  vector<pair<float, string>> slow;
+  for (UMissionProfile & m : missions)
+  {
+    float total = 0;
+    if (m.started.valid and m.ended.valid)
+      total = m.ended - m.started;
+    float delay = 0;
+    if (m.started.valid)
+      delay = m.started - m.sent;
+    if (f != nullptr)
+      fprintf(f, "%% mission '%s' start delay %.1f ms, time %.3f s, distance %.3f m%s\n",
+              m.name.c_str(), delay * 1000, total, m.dist, m.ended.valid ? "" : " (not finished)");
+    for (int i = 0; i < (int)m.segments.size(); i++)
+    {
+      USegment & g = m.segments[i];
+      float v = 0;
+      if (g.time > 0)
+        v = g.dist / g.time;
+      if (f != nullptr)
+        fprintf(f, "%s; %d; %d; %d; %d; %.3f; %.3f; %.3f; %s\n", m.name.c_str(), i, g.fileLine,
+                g.lineCnt, g.entries, g.time, g.dist, v, g.text.c_str());
+      snprintf(s, MSL, "'%s' line %d: %s", m.name.c_str(), g.fileLine, g.text.c_str());
+      slow.push_back(make_pair(g.time, string(s)));
+    }
+  }
+  dataLock.unlock();
+  if (f != nullptr)
+  {
+    fclose(f);
+    printf("# UProfiler:: profile saved to '%s'\n", fn);
+  }
+  sort(slow.begin(), slow.end(), [](const pair<float, string> & a, const pair<float, string> & b)
+  {
+    return a.first > b.first;
+  });
+  printf("# UProfiler:: slowest segments\n");
+  for (int i = 0; i < (int)slow.size() and i < 5; i++)
+    printf("#   %6.2f s %s\n", slow[i].first, slow[i].second.c_str());
+}
@@ -0,0 +1,125 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#ifndef UPROFILER_H
+#define UPROFILER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include "utime.h"
+
+using namespace std;
+
+/**
+ * Time and distance used by each mission and each mission segment.
+ * A segment is one (or a few) mission lines, and the mission lines are
+ * marked with a user event at the start of each segment (see UMission).
+ * Mission start and end (event 33 and 0), the segment events and the
+ * pose updates are used to find time and distance for each segment.
+ * Enabled with 'profile' on the command line; the result is written
+ * to 'profile_yyyyMMdd_hhmmss.mmm.txt' at the end of the run,
+ * one line per segment, so that runs can be compared. */
+class UProfiler
+{
+public:
+  /**
+   * Check for the 'profile' option
+   * must be called before the missions are loaded */
+  void setup(int argc, char **argv);
+  /**
+   * A mission is sent to the robot
+   * \param name is the mission name
+   * \param lines are the mission lines (without the segment events)
+   * \param fileLine is the line number in the mission file
+   * \param segLine is the first mission line in each segment
+   * \param segEvent is the user event that marks each segment */
+  void missionSent(const string & name, const vector<string> & lines, const vector<int> & fileLine, 
+                   const vector<int> & segLine, const vector<int> & segEvent);
+  /**
+   * An event is received from the robot (from UEvent)
+   * \param e is the event number
+   * \param t is the time the event was received */
+  void onEvent(int e, UTime t);
+  /**
+   * New pose received (from UPose)
+   * \param x,y is the position in odometry coordinates */
+  void onPose(float x, float y);
+  /**
+   * Print the slowest segments and write the report file */
+  void report();
+  /// is the profiler enabled
+  bool enabled = false;
+  
+private:
+  /**
+   * Data for one segment */
+  class USegment
+  {
+  public:
+    /// first mission line (index) and line number in file
+    int line;
+    int fileLine;
+    /// number of lines in segment
+    int lineCnt;
+    /// first mission line
+    string text;
+    /// number of times the segment is started (more if a 'goto' is used)
+    int entries = 0;
+    /// time (sec) and distance (m) in this segment
+    float time = 0;
+    float dist = 0;
+  };
+  /**
+   * Data for one mission (one upload) */
+  class UMissionProfile
+  {
+  public:
+    string name;
+    UTime sent;
+    UTime started;
+    UTime ended;
+    float dist = 0;
+    vector<USegment> segments;
+    /// segment index for each event number (-1 if not a segment event)
+    int eventSeg[34];
+  };
+  /// end the current segment
+  void closeSegment(UMissionProfile & m, UTime t);
+  vector<UMissionProfile> missions;
+  /// current segment index, -1 if none
+  int current = -1;
+  UTime segmentStart;
+  /// mission is running (between event 33 and 0)
+  bool active = false;
+  /// last pose
+  float lastX, lastY;
+  bool lastValid = false;
+  mutex dataLock;
+};
+
+/**
+ * Make this visible to the rest of the software */
+extern UProfiler profiler;
+
+#endif
@@ -0,0 +1,240 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, 
+ * Author:
+ * Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+#include <stdio.h>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "uscheduler.h"
+#include "uevent.h"
+#include "uvision.h"
+#include "uplay.h"
+
+// create value
+UScheduler scheduler;
+
+
+UWait::UWait(function<bool()> condition, float timeout)
+{
+  ready = condition;
+  if (timeout >= 0)
+  {
+    deadline.now();
+    deadline += timeout;
+  }
+}
+
+bool UWait::await_ready()
+{
+  ok = ready();
+  return ok;
+}
+
+void UWait::await_suspend(coroutine_handle<> h)
+{
+  scheduler.addWaiter(this, h);
+}
+
+void UScheduler::addWaiter(UWait * wait, coroutine_handle<> h)
+{
+  UWaiter w;
+  w.wait = wait;
+  w.h = h;
+  waiters.push_back(w);
+}
+
+void UScheduler::spawn(UTask & task)
+{
+  if (not task.done() and not task.h.promise().started)
+  {
+    task.h.promise().started = true;
+    ready.push_back(task.h);
+  }
+}
+
+void UScheduler::spawn(UTask && task)
+{
+  owned.push_back(move(task));
+  spawn(owned.back());
+}
+
+void UScheduler::run(UTask && task)
+{
+  UTask t = move(task);
+  run(t);
+}
+
+void UScheduler::run(UTask & task)
+{
+  spawn(task);
+  while (not task.done())
+  {
+    runReady();
+    if (task.done())
+      break;
+    if (not testWaiters())
+      sleepUntilNotified();
+  }
+  // remove finished tasks owned by the scheduler
+  for (int i = owned.size() - 1; i >= 0; i--)
+  {
+    if (owned[i].done())
+      owned.erase(owned.begin() + i);
+  }
+}
+
+void UScheduler::runReady()
+{
+  while (not ready.empty())
+  { // a resumed task may make other tasks ready
+    vector<coroutine_handle<>> now;
+    now.swap(ready);
+    for (coroutine_handle<> h : now)
+      h.resume();
+  }
+}
+
+bool UScheduler::testWaiters()
+{
+  bool any = false;
+  UTime t;
+  t.now();
+  for (int i = 0; i < (int)waiters.size(); )
+  {
+    UWait * w = waiters[i].wait;
+    bool timeout = false;
+    w->ok = w->ready();
+    if (not w->ok and w->deadline.valid)
+      timeout = t >= w->deadline;
+    if (w->ok or timeout)
+    {
+      ready.push_back(waiters[i].h);
+      waiters.erase(waiters.begin() + i);
+      any = true;
+    }
+    else
+      i++;
+  }
+  return any;
+}
+
+void UScheduler::sleepUntilNotified()
+{ // wait max 1 second, or until the next timeout
+  float dt = 1.0;
+  for (UWaiter & w : waiters)
+  {
+    if (w.wait->deadline.valid)
+    {
+      float d = -w.wait->deadline.getTimePassed();
+      if (d < dt)
+        dt = d;
+    }
+  }
+  unique_lock<mutex> lock(notifyLock);
+  if (dt > 0 and not notified)
+    wake.wait_for(lock, chrono::microseconds(int(dt * 1e6)), [this]{ return notified; });
+  notified = false;
+}
+
+void UScheduler::notify()
+{
+  {
+    lock_guard<mutex> lock(notifyLock);
+    notified = true;
+  }
+  wake.notify_one();
+}
+
+UWait UScheduler::until(function<bool()> condition, float timeout)
+{
+  return UWait(condition, timeout);
+}
+
+UWait UScheduler::sleep(float seconds)
+{
+  return UWait([](){ return false; }, seconds);
+}
+
+UWait UScheduler::untilEvent(int n, float timeout)
+{
+  return UWait([n](){ return event.gotEvent(n); }, timeout);
+}
+
+UWait UScheduler::untilVision(UVisionResult & result, float timeout)
+{
+  return UWait([&result](){ return vision.getResult(result); }, timeout);
+}
+
+UWait UScheduler::untilLine(ULineResult & result, float timeout)
+{
+  return UWait([&result](){ return vision.getLine(result); }, timeout);
+}
+
+UTask UScheduler::say(string sentence, float volume)
+{
+  int serial;
+  {
+    lock_guard<mutex> lock(speechLock);
+    serial = ++sentenceCnt;
+    sentences.push_back({sentence, volume, serial});
+    if (speaker == nullptr)
+      // text2wave and play are blocking system calls
+      speaker = new thread(&UScheduler::speechLoop, this);
+  }
+  speechWake.notify_one();
+  co_await until([this, serial](){ return saidCnt.load() >= serial; });
+}
+
+void UScheduler::speechLoop()
+{
+  while (true)
+  {
+    USentence s;
+    {
+      unique_lock<mutex> lock(speechLock);
+      speechWake.wait(lock, [this](){ return speechStop or not sentences.empty(); });
+      if (sentences.empty())
+        break;
+      s = sentences.front();
+      sentences.pop_front();
+    }
+    sound.say(s.text.c_str(), s.volume);
+    saidCnt = s.serial;
+    notify();
+  }
+}
+
+UScheduler::~UScheduler()
+{
+  if (speaker != nullptr)
+  { // queued sentences are said first
+    {
+      lock_guard<mutex> lock(speechLock);
+      speechStop = true;
+    }
+    speechWake.notify_one();
+    speaker->join();
+    speaker = nullptr;
+  }
+}
@@ -0,0 +1,245 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#ifndef USCHEDULER_H
+#define USCHEDULER_H
+
+#include <coroutine>
+#include <functional>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <atomic>
+#include "utime.h"
+
+using namespace std;
+
+class UVisionResult;
+class ULineResult;
+
+/**
+ * A mission task (coroutine), e.g.
+ *   UTask seesaw()
+ *   {
+ *     mission.upload("seesaw", true);
+ *     co_await scheduler.untilEvent(0);
+ *   }
+ * The task is started when spawned in the scheduler or when
+ * awaited by another task (co_await task), and a task awaiting
+ * another task continues when that task is finished. */
+class UTask
+{
+public:
+  class promise_type;
+  using Handle = coroutine_handle<promise_type>;
+  /**
+   * Coroutine state for the task */
+  class promise_type
+  {
+  public:
+    /**
+     * At the end, continue the awaiting task (if any) */
+    class FinalAwait
+    {
+    public:
+      bool await_ready() noexcept { return false; }
+      coroutine_handle<> await_suspend(Handle h) noexcept
+      {
+        if (h.promise().continuation)
+          return h.promise().continuation;
+        return noop_coroutine();
+      }
+      void await_resume() noexcept {}
+    };
+    UTask get_return_object() { return UTask(Handle::from_promise(*this)); }
+    suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwait final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { terminate(); }
+    /// task awaiting this task
+    coroutine_handle<> continuation;
+    /// started by scheduler or by an awaiting task
+    bool started = false;
+  };
+  UTask() {}
+  UTask(UTask && other) noexcept : h(other.h) { other.h = nullptr; }
+  UTask & operator=(UTask && other) noexcept
+  {
+    if (this != &other)
+    {
+      if (h)
+        h.destroy();
+      h = other.h;
+      other.h = nullptr;
+    }
+    return *this;
+  }
+  UTask(const UTask &) = delete;
+  ~UTask()
+  {
+    if (h)
+      h.destroy();
+  }
+  /**
+   * Is the task finished (or empty) */
+  bool done() { return not h or h.done(); }
+  /// awaiting a task starts it (if not started) and continues when it is finished
+  bool await_ready() { return done(); }
+  coroutine_handle<> await_suspend(coroutine_handle<> caller)
+  {
+    h.promise().continuation = caller;
+    if (h.promise().started)
+      return noop_coroutine();
+    h.promise().started = true;
+    return h;
+  }
+  void await_resume() {}
+
+private:
+  explicit UTask(Handle handle) : h(handle) {}
+  Handle h = nullptr;
+  friend class UScheduler;
+};
+
+/**
+ * Wait for a condition (with optional timeout).
+ * co_await returns true if the condition is met, false on timeout. */
+class UWait
+{
+public:
+  UWait(function<bool()> condition, float timeout);
+  bool await_ready();
+  void await_suspend(coroutine_handle<> h);
+  bool await_resume() { return ok; }
+  /// condition to wait for
+  function<bool()> ready;
+  /// timeout, if deadline is valid
+  UTime deadline;
+  /// condition met
+  bool ok = false;
+};
+
+/**
+ * Single threaded scheduler for mission tasks (coroutines).
+ * All tasks run in the thread calling run(..). Waiting tasks are tested
+ * when new data arrives from the robot (bridge) or vision, or
+ * at a timeout, so there are no polling sleeps. */
+class UScheduler
+{
+public:
+  /** stop the speech thread */
+  ~UScheduler();
+  /**
+   * Run this task (and the spawned tasks) until it is finished */
+  void run(UTask & task);
+  void run(UTask && task);
+  /**
+   * Start a task to run concurrently. The task must exist until
+   * it is finished, e.g. by a 'co_await task' in the spawning task. */
+  void spawn(UTask & task);
+  /**
+   * Start a task to run concurrently, the scheduler keeps the task. */
+  void spawn(UTask && task);
+  /**
+   * Wait until condition is true (or timeout)
+   * \param condition is tested when new data is available
+   * \param timeout in seconds, no timeout if negative
+   * \returns awaitable, co_await gives false on timeout */
+  UWait until(function<bool()> condition, float timeout = -1);
+  /**
+   * Wait this time (seconds) */
+  UWait sleep(float seconds);
+  /**
+   * Wait for an event from the robot, e.g. event 0 (mission finished)
+   * \returns awaitable, co_await gives false on timeout */
+  UWait untilEvent(int n, float timeout = -1);
+  /**
+   * Wait for a new (stream mode) vision result.
+   * \param result is set to the new result */
+  UWait untilVision(UVisionResult & result, float timeout = -1);
+  /**
+   * Wait for a new (stream mode) line result.
+   * \param result is set to the new result */
+  UWait untilLine(ULineResult & result, float timeout = -1);
+  /**
+   * Say a sentence, the task is finished when the sentence is spoken.
+   * Text to wave conversion and play is in one speech thread,
+   * sentences are queued and said in order, as USay can say one at a time. */
+  UTask say(string sentence, float volume = 0.1);
+  /**
+   * New data is available, wake the scheduler (called by other threads) */
+  void notify();
+  /**
+   * Add waiting task (from UWait) */
+  void addWaiter(UWait * wait, coroutine_handle<> h);
+
+private:
+  /// resume all ready tasks
+  void runReady();
+  /// move waiting tasks with true condition (or timeout) to ready
+  bool testWaiters();
+  /// sleep until notified or a timeout
+  void sleepUntilNotified();
+  class UWaiter
+  {
+  public:
+    UWait * wait;
+    coroutine_handle<> h;
+  };
+  vector<UWaiter> waiters;
+  vector<coroutine_handle<>> ready;
+  /// tasks owned by the scheduler (spawned by value)
+  vector<UTask> owned;
+  mutex notifyLock;
+  condition_variable wake;
+  bool notified = false;
+  /**
+   * A sentence waiting to be said */
+  class USentence
+  {
+  public:
+    string text;
+    float volume;
+    int serial;
+  };
+  /// sentences for the speech thread
+  deque<USentence> sentences;
+  int sentenceCnt = 0;
+  /// serial of the last sentence said
+  atomic<int> saidCnt{0};
+  mutex speechLock;
+  condition_variable speechWake;
+  bool speechStop = false;
+  thread * speaker = nullptr;
+  /// say queued sentences (speech thread)
+  void speechLoop();
+};
+
+/**
+ * Make this visible to the rest of the software */
+extern UScheduler scheduler;
+
+#endif
@@ -0,0 +1,379 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, 
+ * Author:
+ * Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "usequencer.h"
+#include "umission.h"
+#include "uevent.h"
+#include "ustate.h"
+#include "upose.h"
+#include "ubridge.h"
+#include "ujoy.h"
+#include "ulocalize.h"
+
+// create value
+USequencer sequencer;
+
+
+void USequencer::setup(int argc, char **argv)
+{
+  for (int i = 1; i < argc; i++)
+  { // check for command line parameters
+    if (strncmp(argv[i], "from=", 5) == 0)
+      from = &argv[i][5];
+    else if (strcmp(argv[i], "resume") == 0)
+      resume = true;
+  }
+}
+
+USequencer::UStep & USequencer::add(const char * name, function<void()> atStart)
+{
+  steps.emplace_back();
+  UStep & s = steps.back();
+  s.name = name;
+  s.atStart = atStart;
+  return s;
+}
+
+int USequencer::findStep(const char * name)
+{
+  for (int i = 0; i < (int)steps.size(); i++)
+  {
+    if (steps[i].name == name)
+      return i;
+  }
+  // may be a step number
+  char * p1;
+  int i = strtol(name, &p1, 10);
+  if (p1 != name and *p1 == '\0' and i >= 0 and i < (int)steps.size())
+    return i;
+  return -1;
+}
+
+void USequencer::saveCheckpoint(int i)
+{
+  FILE * f = fopen(checkpointFile, "w");
+  if (f != nullptr)
+  {
+    fprintf(f, "%d %s\n", i, steps[i].name.c_str());
+    fclose(f);
+  }
+}
+
+int USequencer::loadCheckpoint()
+{
+  FILE * f = fopen(checkpointFile, "r");
+  if (f == nullptr)
+  {
+    printf("# USequencer:: no checkpoint in '%s', starting from first step\n", checkpointFile);
+    return 0;
+  }
+  const int MLL = 200;
+  char line[MLL] = {'\0'};
+  if (fgets(line, MLL, f) == nullptr)
+    line[0] = '\0';
+  fclose(f);
+  // use the name, if the sequence has changed since saved
+  char * p1 = strchr(line, ' ');
+  int i = -1;
+  if (p1 != nullptr)
+  {
+    p1++;
+    p1[strcspn(p1, "\r\n")] = '\0';
+    i = findStep(p1);
+  }
+  if (i < 0)
+    i = strtol(line, nullptr, 10);
+  printf("# USequencer:: last checkpoint is step %d\n", i);
+  return i + 1;
+}
+
+void USequencer::loadRunTimes()
+{
+  FILE * f = fopen(runTimeFile, "r");
+  if (f == nullptr)
+    return;
+  const int MLL = 200;
+  char line[MLL];
+  while (fgets(line, MLL, f) != nullptr)
+  { // lines are 'seconds x y name' (or 'seconds name' in older files)
+    URun r;
+    char * p1;
+    r.time = strtof(line, &p1);
+    char * p2;
+    char * p3;
+    float x = strtof(p1, &p2);
+    float y = strtof(p2, &p3);
+    if (p2 != p1 and p3 != p2)
+    { // with end position
+      r.x = x;
+      r.y = y;
+      r.hasEnd = true;
+      p1 = p3;
+    }
+    while (*p1 == ' ')
+      p1++;
+    p1[strcspn(p1, "\r\n")] = '\0';
+    if (*p1 != '\0')
+      runTimes[p1] = r;
+  }
+  fclose(f);
+}
+
+void USequencer::saveRunTimes()
+{
+  FILE * f = fopen(runTimeFile, "w");
+  if (f == nullptr)
+    return;
+  for (auto & rt : runTimes)
+  {
+    if (rt.second.hasEnd)
+      fprintf(f, "%.3f %.3f %.3f %s\n", rt.second.time, rt.second.x, rt.second.y, rt.first.c_str());
+    else
+      fprintf(f, "%.3f %s\n", rt.second.time, rt.first.c_str());
+  }
+  fclose(f);
+}
+
+void USequencer::run()
+{
+  scheduler.run(runTask());
+}
+
+UTask USequencer::runStep(int i, const string & name)
+{
+  UStep & s = steps[i];
+  s.tries++;
+  if (mission.stagedName() != name)
+    mission.stage(name.c_str());
+  UTime t;
+  t.now();
+  if (not mission.sendStaged())
+  { // not staged (not found) or not sent
+    printf("# USequencer:: step %d mission '%s' not found or not sent\n", i, name.c_str());
+    s.finished = false;
+    co_return;
+  }
+  if (lastEnd.valid and s.tries == 1)
+    s.idleTime = t - lastEnd;
+  // prepare the next mission while this one is running
+  if (i + 1 < (int)steps.size())
+    mission.stage(steps[i + 1].name.c_str());
+  float timeout = s.timeout;
+  if (timeout <= 0 and runTimes.count(name) > 0)
+    // no fixed timeout, so use the last measured run time with a margin
+    timeout = runTimes[name].time * timeoutFactor + timeoutMargin;
+  else if (timeout <= 0)
+    // not measured (first run, or a fallback)
+    timeout = s.defaultTimeout;
+  printf("# USequencer:: step %d '%s' running (try %d), waiting for event 0 (timeout %.1f s)\n", 
+         i, name.c_str(), s.tries, timeout);
+  // wait until finished (event 0), timeout,
+  // or stop if no mission is started (waited a second for heartbeat status)
+  co_await scheduler.until([&t, timeout](){ return event.gotEvent(0) or 
+                                     (state.controlState == 0 and t.getTimePassed() > 1.0) or
+                                     (timeout > 0 and t.getTimePassed() > timeout); });
+  if (not event.gotEvent(0) and state.controlState != 0)
+  { // timeout, stop the robot
+    printf("# USequencer:: step %d '%s' timeout after %.1f s\n", i, name.c_str(), t.getTimePassed());
+    bridge.tx("regbot stop\n");
+  }
+  s.finished = event.gotEvent(0) and event.gotEvent(s.successEvent);
+  float h;
+  localize.getPose(s.end[0], s.end[1], h);
+  float x = s.end[0];
+  float y = s.end[1];
+  if (s.finished and s.useRegion)
+  { // must end in this region too (in map coordinates)
+    s.finished = x >= fminf(s.region[0], s.region[2]) and x <= fmaxf(s.region[0], s.region[2]) and
+                 y >= fminf(s.region[1], s.region[3]) and y <= fmaxf(s.region[1], s.region[3]);
+    if (not s.finished)
+      printf("# USequencer:: step %d '%s' ended outside region (at %.2f,%.2f)\n", 
+             i, name.c_str(), x, y);
+  }
+  if (s.finished and s.regionSize > 0 and runTimes.count(s.name) > 0 and runTimes[s.name].hasEnd)
+  { // must end where the last full run of the step ended
+    URun & r = runTimes[s.name];
+    float d = hypotf(x - r.x, y - r.y);
+    s.finished = d <= s.regionSize;
+    if (not s.finished)
+      printf("# USequencer:: step %d '%s' ended %.2f m from the last end (%.2f,%.2f), max %.2f m\n", 
+             i, name.c_str(), d, r.x, r.y, s.regionSize);
+  }
+  if (s.finished)
+  { // time of event 0, as received by the bridge
+    lastEnd = event.eventTime(0);
+    s.runTime = lastEnd - t;
+  }
+}
+
+UTask USequencer::runTask()
+{
+  if (steps.empty())
+    co_return;
+  int first = 0;
+  if (resume or (joy.isAvailable() and joy.button(BUTTON_RESUME)))
+    first = loadCheckpoint();
+  else if (not from.empty())
+  {
+    first = findStep(from.c_str());
+    if (first < 0)
+    {
+      printf("# USequencer:: no step '%s' to start from\n", from.c_str());
+      co_return;
+    }
+  }
+  if (first >= (int)steps.size())
+  {
+    printf("# USequencer:: all steps are finished, nothing to resume\n");
+    co_return;
+  }
+  if (first > 0)
+    printf("# USequencer:: starting from step %d '%s'\n", first, steps[first].name.c_str());
+  loadRunTimes();
+  mission.stage(steps[first].name.c_str());
+  lastEnd.clear();
+  for (int i = first; i < (int)steps.size(); i++)
+  {
+    UStep & s = steps[i];
+    s.tries = 0;
+    if (s.atStart)
+      s.atStart();
+    // skip the calibration, if the pose is known from a landmark
+    s.usedLocalized = not s.localized.empty() and mission.getLines(s.localized.c_str()) != nullptr and 
+                      localize.isValid();
+    if (s.usedLocalized)
+    {
+      printf("# USequencer:: step %d '%s' is localized, using '%s'\n", 
+             i, s.name.c_str(), s.localized.c_str());
+      if (s.targetLine >= 0)
+      { // distance to target from the corrected pose
+        float x, y, h;
+        localize.getPose(x, y, h);
+        float d = fmaxf(hypotf(s.target[0] - x, s.target[1] - y) - s.targetOffset, 0);
+        if (mission.setLineValue(s.localized.c_str(), s.targetLine, "dist", d))
+          printf("# USequencer:: robot at (%.2f, %.2f), dist=%.3f to target in line %d\n", 
+                 x, y, d, s.targetLine);
+        else
+          printf("# USequencer:: no 'dist' in line %d of '%s'\n", s.targetLine, s.localized.c_str());
+      }
+      // the changed (or not pre-staged) mission
+      mission.stage(s.localized.c_str());
+      co_await runStep(i, s.localized);
+    }
+    else
+      co_await runStep(i, s.name);
+    if (not s.finished and not s.fallback.empty())
+    { // try the fallback mission from where the robot is now
+      printf("# USequencer:: step %d '%s' failed, trying fallback '%s'\n", 
+             i, s.name.c_str(), s.fallback.c_str());
+      co_await runStep(i, s.fallback);
+    }
+    bool stop = false;
+    while (not s.finished and not stop)
+    { // let the operator decide
+      if (not joy.isAvailable())
+      {
+        printf("# USequencer:: step %d '%s' failed, stopping sequence (restart with 'resume')\n", 
+               i, s.name.c_str());
+        stop = true;
+        break;
+      }
+      printf("# USequencer:: step %d '%s' failed, press button %d to retry, %d to skip, %d to stop\n", 
+             i, s.name.c_str(), BUTTON_RETRY, BUTTON_SKIP, BUTTON_STOP);
+      // remember the button, it may be released before the task continues
+      int pressed = 0;
+      co_await scheduler.until([&pressed](){ 
+        for (int b : {BUTTON_RETRY, BUTTON_SKIP, BUTTON_STOP})
+        {
+          if (joy.button(b))
+          {
+            pressed = b;
+            return true;
+          }
+        }
+        return false; }, 120);
+      if (pressed > 0)
+        // wait for release, so a held button is not used for the next question
+        co_await scheduler.until([pressed](){ return not joy.button(pressed); }, 10);
+      if (pressed == BUTTON_RETRY)
+        co_await runStep(i, s.name);
+      else if (pressed == BUTTON_SKIP)
+      {
+        printf("# USequencer:: step %d '%s' skipped\n", i, s.name.c_str());
+        break;
+      }
+      else
+        stop = true;
+    }
+    if (stop)
+      break;
+    if (s.finished)
+    {
+      saveCheckpoint(i);
+      // compare run times for first tries only
+      if (s.tries == 1 and not s.usedLocalized)
+      {
+        URun & r = runTimes[s.name];
+        r.time = s.runTime;
+        r.x = s.end[0];
+        r.y = s.end[1];
+        r.hasEnd = true;
+      }
+      else if (s.tries == 1 and runTimes.count(s.name) > 0)
+        s.saved = runTimes[s.name].time - s.runTime;
+    }
+  }
+  saveRunTimes();
+  printStats();
+}
+
+void USequencer::printStats()
+{
+  float idle = 0;
+  float run = 0;
+  float saved = 0;
+  int localized = 0;
+  printf("# USequencer:: step, idle before (ms), run time (s), mission\n");
+  for (int i = 0; i < (int)steps.size(); i++)
+  {
+    UStep & s = steps[i];
+    printf("#   %d, %7.2f, %7.2f, %s%s (%d tries)\n", i, s.idleTime * 1000, s.runTime, 
+           s.name.c_str(), s.finished ? "" : " (not finished)", s.tries);
+    if (s.usedLocalized)
+    {
+      printf("#      localized with '%s', saved %.2f s\n", s.localized.c_str(), s.saved);
+      saved += s.saved;
+      localized++;
+    }
+    idle += s.idleTime;
+    run += s.runTime;
+  }
+  printf("# USequencer:: total idle %.2f ms in transitions, total run %.2f s\n", idle * 1000, run);
+  if (localized > 0)
+    printf("# USequencer:: %d steps localized (no calibration), saved %.2f s\n", localized, saved);
+}
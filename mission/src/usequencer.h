@@ -0,0 +1,168 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#ifndef USEQUENCER_H
+#define USEQUENCER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include "utime.h"
+#include "uscheduler.h"
+
+using namespace std;
+
+/**
+ * Runs the challenges (missions) one after the other.
+ * The next mission is staged (made ready as one block) while
+ * the current is running, and is sent as soon as the
+ * current mission ends (event 0).
+ * The idle time from end of one mission to the start of the next
+ * is saved for each transition.
+ * Each step is a checkpoint, it is a success when the success event is
+ * received before the timeout (and the robot is in the region, or near
+ * the end of the last full run, if set).
+ * A failed step is tried again with the fallback mission (if any),
+ * then the operator can retry, skip or stop (joystick buttons).
+ * The sequence can start at any step with 'from=name' (or from=N), or
+ * continue after the last successful step with 'resume' (or joystick button).
+ * A step can have a localized variant, a shorter mission without the
+ * calibration manoeuvre, used when there is a recent landmark fix (see ULocalize).
+ * A distance in the localized variant can be set from the map pose.
+ * The run time and end position of each full mission is saved, to
+ * report the time saved, and for the timeout and region of the next run. */
+class USequencer
+{
+public:
+  /**
+   * A step in the sequence (a challenge) */
+  class UStep
+  {
+  public:
+    string name;
+    function<void()> atStart;
+    /// success criteria: event within timeout (sec), if timeout <= 0 the
+    /// timeout is from the last measured run time, or defaultTimeout if not measured
+    int successEvent = 0;
+    float timeout = 0;
+    float defaultTimeout = 120;
+    /// success criteria: robot in this region (x1,y1,x2,y2), if set
+    bool useRegion = false;
+    float region[4];
+    /// success criteria: robot within this distance (m) of where the last
+    /// full run ended (map coordinates), 0 if not used
+    float regionSize = 0;
+    /// map position at the end of the step
+    float end[2] = {0, 0};
+    /// mission to try if the step fails (empty if none)
+    string fallback;
+    /// mission to use if localized (without calibration), empty if none
+    string localized;
+    /// line in the localized mission with a 'dist' condition that is set from
+    /// the map pose: distance to 'target' (map x,y) less 'targetOffset', -1 if none
+    int targetLine = -1;
+    float target[2] = {0, 0};
+    float targetOffset = 0;
+    /// the localized mission was used
+    bool usedLocalized = false;
+    /// time saved by the localized mission (sec), compared to last full run
+    float saved = 0;
+    /// time from end of last mission to this mission is sent (sec)
+    float idleTime = 0;
+    /// time from sent to success event (sec)
+    float runTime = 0;
+    /// number of tries (first, fallback and retry)
+    int tries = 0;
+    /// success event received (and in region)
+    bool finished = false;
+  };
+  /**
+   * Check for 'from=name', 'from=N' or 'resume' options */
+  void setup(int argc, char **argv);
+  /**
+   * Add a step to the sequence
+   * \param name is the mission name (section in missions file)
+   * \param atStart is called just before the mission is sent,
+   * e.g. to spawn a task that says something while the mission runs
+   * \returns the step, to set success criteria and fallback */
+  UStep & add(const char * name, function<void()> atStart = nullptr);
+  /**
+   * Run all steps in sequence, returns when the last mission is finished
+   * (or when stopped) */
+  void run();
+  /**
+   * The sequence as a task, to run with other tasks in the scheduler */
+  UTask runTask();
+  /**
+   * Print idle time for each transition and run time of each step */
+  void printStats();
+  /// timeout from measured run time (sec): factor * run time + margin
+  float timeoutFactor = 1.5;
+  float timeoutMargin = 10;
+  /// joystick buttons for the operator
+  static const int BUTTON_RETRY = 1;
+  static const int BUTTON_SKIP = 2;
+  static const int BUTTON_STOP = 3;
+  static const int BUTTON_RESUME = 4;
+
+private:
+  /**
+   * Send a mission (step or fallback) and wait for the success criteria,
+   * sets s.finished */
+  UTask runStep(int i, const string & name);
+  /// index of step with this name or number, -1 if not found
+  int findStep(const char * name);
+  /// save last successful step
+  void saveCheckpoint(int i);
+  /// step after the last saved checkpoint (0 if none)
+  int loadCheckpoint();
+  /// load and save run time of full missions
+  void loadRunTimes();
+  void saveRunTimes();
+  /**
+   * Last full (not localized) first try of a mission */
+  class URun
+  {
+  public:
+    float time = 0;
+    /// end position (map coordinates)
+    float x = 0, y = 0;
+    bool hasEnd = false;
+  };
+  map<string, URun> runTimes;
+  vector<UStep> steps;
+  /// first step to run (name or number from command line)
+  string from;
+  bool resume = false;
+  /// end of last mission (success event)
+  UTime lastEnd;
+  static constexpr const char * checkpointFile = "checkpoint.txt";
+  static constexpr const char * runTimeFile = "steptimes.txt";
+};
+
+/**
+ * Make this visible to the rest of the software */
+extern USequencer sequencer;
+
+#endif
@@ -0,0 +1,660 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, 
+ * Author:
+ * Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+#include <unistd.h>
+#include "usimcore.h"
+#include "ubridge.h"
+#include "ulocalize.h"
+
+// create value
+USimCore simcore;
+
+
+USimCore::~USimCore()
+{
+  stop();
+}
+
+bool USimCore::setup(int argc, char **argv)
+{
+  const char * track = nullptr;
+  for (int i = 1; i < argc; i++)
+  { // check for command line parameters
+    if (strcmp(argv[i], "sim") == 0)
+      active = true;
+    else if (strncmp(argv[i], "track=", 6) == 0)
+      track = &argv[i][6];
+    else if (strncmp(argv[i], "simspeed=", 9) == 0)
+      speed = strtof(&argv[i][9], nullptr);
+  }
+  if (not active)
+    return false;
+  if (speed <= 0)
+    speed = 1;
+  if (track == nullptr or not loadTrack(track))
+  { // default track is a straight line
+    USegment s = {-1, 0, 20, 0};
+    tape.push_back(s);
+  }
+  x = startX;
+  y = startY;
+  h = startH;
+  ox = x;
+  oy = y;
+  oh = h;
+  printf("# USimCore:: simulated robot, %d lines, %d walls and %d markers in track, %g times real time\n", 
+         (int)tape.size(), (int)walls.size(), (int)markers.size(), speed);
+  simThread = new thread(startloop, this);
+  return true;
+}
+
+void USimCore::stop()
+{
+  if (simThread != nullptr)
+  {
+    terminate = true;
+    simThread->join();
+    simThread = nullptr;
+  }
+}
+
+bool USimCore::loadTrack(const char * file)
+{
+  FILE * f = fopen(file, "r");
+  if (f == nullptr)
+  {
+    printf("# USimCore:: failed to open track '%s'\n", file);
+    return false;
+  }
+  const int MLL = 200;
+  char line[MLL];
+  while (fgets(line, MLL, f) != nullptr)
+  {
+    char * p1 = strchr(line, '#');
+    if (p1 != nullptr)
+      *p1 = '\0';
+    USegment s;
+    if (sscanf(line, " line %f %f %f %f", &s.x1, &s.y1, &s.x2, &s.y2) == 4)
+      tape.push_back(s);
+    else if (sscanf(line, " wall %f %f %f %f", &s.x1, &s.y1, &s.x2, &s.y2) == 4)
+      walls.push_back(s);
+    else if (sscanf(line, " start %f %f %f", &startX, &startY, &startH) == 3)
+      startH *= M_PI / 180;
+    else
+    {
+      USimMarker m;
+      if (sscanf(line, " marker %d %f %f %f", &m.id, &m.x, &m.y, &m.h) == 4)
+      {
+        m.h *= M_PI / 180;
+        markers.push_back(m);
+      }
+      else
+        sscanf(line, " drift %f", &drift);
+    }
+  }
+  fclose(f);
+  return not tape.empty();
+}
+
+void USimCore::receive(const char * data)
+{
+  const char * p1 = data;
+  while (*p1 != '\0')
+  {
+    const char * p2 = strchrnul(p1, '\n');
+    if (*p1 == ';' and p2 - p1 > 3)
+      // skip CRC
+      p1 += 3;
+    string line(p1, p2 - p1);
+    command(line.c_str());
+    p1 = p2;
+    if (*p1 == '\n')
+      p1++;
+  }
+}
+
+void USimCore::command(const char * line)
+{
+  dataLock.lock();
+  if (strncmp(line, "regbot madd ", 12) == 0)
+  {
+    USimLine m;
+    if (decodeLine(&line[12], m))
+      lines.push_back(m);
+  }
+  else if (strncmp(line, "regbot mclear", 13) == 0)
+  {
+    lines.clear();
+    current = -1;
+    controlState = 0;
+  }
+  else if (strncmp(line, "regbot start", 12) == 0)
+  {
+    if (not lines.empty())
+    {
+      current = 0;
+      controlState = 2;
+      minMargin = SENSOR_HALF_WIDTH;
+      outbox.push_back("regbot:event 33");
+      startLine();
+    }
+  }
+  else if (strncmp(line, "regbot stop", 11) == 0)
+  {
+    current = -1;
+    velRef = 0;
+    controlState = 0;
+  }
+  // other commands (subscribe, mute, ...) are accepted silently
+  dataLock.unlock();
+}
+
+bool USimCore::decodeLine(const char * line, USimLine & m)
+{
+  m.text = line;
+  string s = line;
+  size_t colon = s.find(':');
+  string a = s.substr(0, colon);
+  string c;
+  if (colon != string::npos)
+    c = s.substr(colon + 1);
+  // assignments
+  char * save = nullptr;
+  char * item = strtok_r(&a[0], ",", &save);
+  while (item != nullptr)
+  {
+    while (isspace(*item))
+      item++;
+    char * p1 = item;
+    while (isalnum(*p1))
+      p1++;
+    string name(item, p1 - item);
+    p1 = strchr(p1, '=');
+    if (p1 != nullptr and not name.empty())
+    {
+      float v = strtof(p1 + 1, nullptr);
+      if (name == "label")
+        m.label = v;
+      else if (name == "goto")
+        m.gotoLabel = v;
+      else
+        m.assign.push_back(make_pair(name, v));
+    }
+    item = strtok_r(nullptr, ",", &save);
+  }
+  // conditions
+  item = strtok_r(&c[0], ",", &save);
+  while (item != nullptr)
+  {
+    while (isspace(*item))
+      item++;
+    char * p1 = item;
+    while (isalnum(*p1))
+      p1++;
+    UCondition cond;
+    cond.name = string(item, p1 - item);
+    while (isspace(*p1))
+      p1++;
+    cond.op = *p1;
+    if (*p1 != '\0')
+      p1++;
+    if (*p1 == '=')
+      p1++;
+    cond.value = strtof(p1, nullptr);
+    if (not cond.name.empty())
+      m.conditions.push_back(cond);
+    item = strtok_r(nullptr, ",", &save);
+  }
+  return true;
+}
+
+void USimCore::warnOnce(const string & name)
+{
+  for (const string & w : warned)
+  {
+    if (w == name)
+      return;
+  }
+  warned.push_back(name);
+  printf("# USimCore:: '%s' is not simulated\n", name.c_str());
+}
+
+void USimCore::startLine()
+{
+  USimLine & m = lines[current];
+  lineDist = 0;
+  lineTurn = 0;
+  lineTime = 0;
+  // straight (holding heading), unless told otherwise
+  mode = 0;
+  headRef = h;
+  for (const pair<string, float> & a : m.assign)
+  {
+    if (a.first == "vel")
+      velRef = a.second;
+    else if (a.first == "acc")
+      acc = a.second;
+    else if (a.first == "tr")
+    {
+      mode = 1;
+      turnRadius = a.second;
+    }
+    else if (a.first == "edgel" or a.first == "edger")
+    {
+      mode = 2;
+      edge = (a.first == "edgel") ? 1 : -1;
+      edgeOffset = a.second;
+    }
+    else if (a.first == "head")
+      headRef = a.second * M_PI / 180;
+    else if (a.first == "event")
+    {
+      const int MSL = 30;
+      char s[MSL];
+      snprintf(s, MSL, "regbot:event %d", int(a.second));
+      outbox.push_back(s);
+    }
+    else if (a.first != "servo" and a.first != "pservo" and a.first != "vservo" and a.first != "log")
+      warnOnce(a.first);
+  }
+}
+
+float USimCore::conditionValue(const string & name, bool & known)
+{
+  known = true;
+  if (name == "xl")
+    return xl;
+  else if (name == "lv")
+    return lv;
+  else if (name == "ir1")
+    return irDistance(M_PI / 2);
+  else if (name == "ir2")
+    return irDistance(0);
+  else if (name == "vel")
+    return vel;
+  known = false;
+  return 0;
+}
+
+bool USimCore::lineFinished()
+{
+  USimLine & m = lines[current];
+  if (m.conditions.empty() or m.gotoLabel >= 0)
+    // no conditions, continue at once
+    return true;
+  for (const UCondition & c : m.conditions)
+  {
+    bool known = true;
+    bool met = false;
+    if (c.name == "dist")
+      met = (c.op == '<') ? lineDist < c.value : lineDist >= c.value;
+    else if (c.name == "turn")
+    {
+      float deg = lineTurn * 180 / M_PI;
+      met = (c.value >= 0) ? deg >= c.value : deg <= c.value;
+    }
+    else if (c.name == "time")
+      met = (c.op == '<') ? lineTime < c.value : lineTime >= c.value;
+    else if (c.name == "count")
+      met = false;
+    else
+    {
+      float v = conditionValue(c.name, known);
+      if (c.op == '<')
+        met = v < c.value;
+      else if (c.op == '>')
+        met = v > c.value;
+      else
+        met = v >= c.value;
+    }
+    if (not known)
+      warnOnce(c.name);
+    // any condition will end the line
+    if (met)
+      return true;
+  }
+  return false;
+}
+
+void USimCore::nextLine()
+{
+  USimLine & m = lines[current];
+  int next = current + 1;
+  if (m.gotoLabel >= 0)
+  { // 'goto=1 : count=2' jumps 2 times, and then continues
+    int n = -1;
+    for (const UCondition & c : m.conditions)
+    {
+      if (c.name == "count")
+        n = c.value;
+    }
+    m.count++;
+    if (n >= 0 and m.count > n)
+      m.count = 0;
+    else
+    {
+      for (int i = 0; i < (int)lines.size(); i++)
+      {
+        if (lines[i].label == m.gotoLabel)
+        {
+          next = i;
+          break;
+        }
+      }
+    }
+  }
+  if (next >= (int)lines.size())
+  { // mission finished
+    current = -1;
+    velRef = 0;
+    controlState = 0;
+    outbox.push_back("regbot:event 0");
+  }
+  else
+  {
+    current = next;
+    startLine();
+  }
+}
+
+void USimCore::lineSensor()
+{ // sensor bar across the robot in front of the wheels
+  float cx = x + SENSOR_DIST * cosf(h);
+  float cy = y + SENSOR_DIST * sinf(h);
+  float px = -sinf(h);
+  float py = cosf(h);
+  int cnt = 0;
+  float left = 0;
+  float right = 0;
+  for (int i = 0; i < SENSOR_CNT; i++)
+  { // position of sensor (left is positive)
+    float u = SENSOR_HALF_WIDTH * (2.0 * i / (SENSOR_CNT - 1) - 1);
+    float sx = cx + u * px;
+    float sy = cy + u * py;
+    bool black = false;
+    for (const USegment & s : tape)
+    { // distance from sensor to tape center line
+      float dx = s.x2 - s.x1;
+      float dy = s.y2 - s.y1;
+      float len2 = dx * dx + dy * dy;
+      float w = 0;
+      if (len2 > 0)
+        w = fmaxf(0, fminf(1, ((sx - s.x1) * dx + (sy - s.y1) * dy) / len2));
+      if (hypotf(s.x1 + w * dx - sx, s.y1 + w * dy - sy) < TAPE_WIDTH / 2)
+      {
+        black = true;
+        break;
+      }
+    }
+    if (black)
+    {
+      if (cnt == 0)
+        right = u;
+      left = u;
+      cnt++;
+    }
+  }
+  // counts as on the regbot, 20 is a sure detect,
+  // a line across the robot covers most sensors
+  xl = (cnt > SENSOR_CNT * 3 / 4) ? 20 : 0;
+  lv = (cnt > 0 and xl == 0) ? 20 : 0;
+  if (lv > 0)
+  { // edge is half a sensor distance further out
+    float half = SENSOR_HALF_WIDTH / (SENSOR_CNT - 1);
+    lineLeft = left + half;
+    lineRight = right - half;
+  }
+}
+
+float USimCore::irDistance(float angle)
+{
+  float a = h + angle;
+  float dx = cosf(a);
+  float dy = sinf(a);
+  float dist = IR_MAX;
+  for (const USegment & s : walls)
+  {
+    float ex = s.x2 - s.x1;
+    float ey = s.y2 - s.y1;
+    float den = dx * ey - dy * ex;
+    if (fabsf(den) < 1e-6)
+      continue;
+    float r = ((s.x1 - x) * ey - (s.y1 - y) * ex) / den;
+    float w = ((s.x1 - x) * dy - (s.y1 - y) * dx) / den;
+    if (r > 0 and w >= 0 and w <= 1 and r < dist)
+      dist = r;
+  }
+  return dist;
+}
+
+void USimCore::step(float dt)
+{ // velocity with acceleration limit
+  float dv = velRef - vel;
+  float maxDv = acc * dt;
+  if (dv > maxDv)
+    dv = maxDv;
+  else if (dv < -maxDv)
+    dv = -maxDv;
+  vel += dv;
+  float fwd = vel;
+  float w = 0;
+  lineSensor();
+  if (current < 0)
+    // no mission, just stop
+    velRef = 0;
+  else if (mode == 1)
+  { // turn direction from turn condition
+    float dir = 1;
+    for (const UCondition & c : lines[current].conditions)
+    {
+      if (c.name == "turn" and c.value < 0)
+        dir = -1;
+    }
+    if (turnRadius < 0.01)
+    { // turn on the spot, vel is wheel velocity
+      w = dir * fabsf(vel) / (WHEEL_BASE / 2);
+      fwd = 0;
+    }
+    else
+      w = dir * vel / turnRadius;
+  }
+  else if (mode == 2)
+  { // follow edge of line (pure pursuit), offset in cm
+    if (lv > 0)
+    {
+      float e = ((edge > 0) ? lineLeft : lineRight) - edgeOffset * 0.01;
+      w = 2 * fwd * e / (SENSOR_DIST * SENSOR_DIST);
+      minMargin = fminf(minMargin, SENSOR_HALF_WIDTH - fmaxf(fabsf(lineLeft), fabsf(lineRight)));
+    }
+    else
+      // line lost
+      minMargin = 0;
+  }
+  else
+  { // hold heading
+    float e = headRef - h;
+    if (e > M_PI)
+      e -= 2 * M_PI;
+    else if (e < -M_PI)
+      e += 2 * M_PI;
+    w = 5 * e;
+  }
+  if (w > 6)
+    w = 6;
+  else if (w < -6)
+    w = -6;
+  turnRate = w;
+  x += fwd * cosf(h) * dt;
+  y += fwd * sinf(h) * dt;
+  h += w * dt;
+  if (h > M_PI)
+    h -= 2 * M_PI;
+  else if (h < -M_PI)
+    h += 2 * M_PI;
+  // odometry, with heading drift
+  ox += fwd * cosf(oh) * dt;
+  oy += fwd * sinf(oh) * dt;
+  oh += (w + drift * fabsf(fwd)) * dt;
+  if (oh > M_PI)
+    oh -= 2 * M_PI;
+  else if (oh < -M_PI)
+    oh += 2 * M_PI;
+  if (current >= 0)
+  {
+    lineDist += fabsf(fwd) * dt;
+    lineTurn += w * dt;
+    lineTime += dt;
+    // lines without a (true) condition are finished at once
+    for (int i = 0; i < 100 and current >= 0 and lineFinished(); i++)
+      nextLine();
+  }
+}
+
+int USimCore::camera(UArucoResult & r)
+{
+  r.markerCnt = 0;
+  for (const USimMarker & m : markers)
+  {
+    float dx = m.x - x;
+    float dy = m.y - y;
+    float d = hypotf(dx, dy);
+    float bearing = remainderf(atan2f(dy, dx) - h, 2 * M_PI);
+    // marker front must face the robot
+    float facing = remainderf(atan2f(-dy, -dx) - m.h, 2 * M_PI);
+    if (d < CAM_RANGE and fabsf(bearing) < CAM_HALF_FOV and fabsf(facing) < M_PI / 3 and 
+        r.markerCnt < UArucoResult::MAX_MARKERS)
+    { // in robot coordinates
+      UArucoMarker & a = r.marker[r.markerCnt++];
+      a.id = m.id;
+      a.pos[0] = cosf(h) * dx + sinf(h) * dy;
+      a.pos[1] = -sinf(h) * dx + cosf(h) * dy;
+      a.pos[2] = 0.1;
+      a.heading = remainderf(m.h - h, 2 * M_PI);
+      a.dist = d;
+    }
+  }
+  return r.markerCnt;
+}
+
+void USimCore::send(const char * msg)
+{ // add CRC, as sent by the bridge
+  string line;
+  UBridge::frameLine(msg, line);
+  bridge.simReceive(line);
+}
+
+void USimCore::startloop(USimCore * sim)
+{
+  sim->run();
+}
+
+bool USimCore::runOffline(const vector<string> & mission, float maxTime, float & time, float & margin)
+{
+  if (tape.empty())
+  { // default track is a straight line
+    USegment s = {-1, 0, 20, 0};
+    tape.push_back(s);
+  }
+  lines.clear();
+  for (const string & m : mission)
+  {
+    USimLine line;
+    if (decodeLine(m.c_str(), line))
+      lines.push_back(line);
+  }
+  x = startX;
+  y = startY;
+  h = startH;
+  ox = x;
+  oy = y;
+  oh = h;
+  vel = 0;
+  velRef = 0;
+  acc = 1.0;
+  t = 0;
+  minMargin = SENSOR_HALF_WIDTH;
+  if (lines.empty())
+    return false;
+  current = 0;
+  controlState = 2;
+  startLine();
+  while (current >= 0 and t < maxTime)
+  {
+    step(DT);
+    t += DT;
+    // no bridge to send to
+    outbox.clear();
+  }
+  time = t;
+  margin = minMargin;
+  return current < 0;
+}
+
+void USimCore::run()
+{
+  const float dt = DT;
+  // pose every 10 ms and heartbeat every 100 ms (virtual time)
+  int n = 0;
+  vector<string> msgs;
+  const int MSL = 200;
+  char s[MSL];
+  while (not terminate and not bridge.terminate)
+  {
+    dataLock.lock();
+    step(dt);
+    t += dt;
+    n++;
+    if (n % 2 == 0)
+    {
+      snprintf(s, MSL, "regbot:pose %.4f %.4f %.4f %.4f 0", t, ox, oy, oh);
+      outbox.push_back(s);
+    }
+    // camera frame every 100 ms (virtual time)
+    UArucoResult r;
+    if (n % 20 == 0 and not markers.empty())
+      camera(r);
+    if (n % 20 == 0)
+    {
+      snprintf(s, MSL, "regbot:hbt %.4f 0 0 12.0 %d 0", t, controlState);
+      outbox.push_back(s);
+    }
+    msgs.swap(outbox);
+    dataLock.unlock();
+    // decode may send to the robot, so without lock
+    for (const string & m : msgs)
+      send(m.c_str());
+    msgs.clear();
+    if (r.markerCnt > 0)
+    { // image is taken after the last pose
+      r.imageTime.now();
+      localize.onMarkers(r);
+    }
+    usleep(int(dt / speed * 1e6));
+  }
+}
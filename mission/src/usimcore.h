@@ -0,0 +1,219 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#ifndef USIMCORE_H
+#define USIMCORE_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include "uaruco.h"
+
+using namespace std;
+
+/**
+ * Simple simulation of the regbot, used in place of the bridge
+ * connection with the 'sim' option.
+ * The subset of mission lines used in missions.txt is simulated:
+ *   vel, acc, tr, edgel, edger, head, label, goto, event (assignments)
+ *   dist, turn, time, count, xl, lv, ir, ir1, ir2, vel (conditions)
+ * servo and log assignments are accepted, but do nothing.
+ * Pose, heartbeat (hbt) and event messages are sent through the
+ * normal bridge decode path, with the time from a virtual clock.
+ * The track is loaded with 'track=file', the file has lines like
+ *   line x1 y1 x2 y2    # tape line (meter), crossing if across the robot
+ *   wall x1 y1 x2 y2    # obstacle for the IR distance sensors
+ *   start x y h         # start pose (h in degrees)
+ *   marker id x y h     # ArUco marker facing h (degrees), seen by a simulated camera
+ *   drift r             # odometry heading error (radians per meter driven)
+ * with a straight line along the x-axis as default.
+ * The reported (odometry) pose starts at the start pose, and differs from the
+ * true pose only if 'drift' is set. Markers in view of the camera are given
+ * to the localization (as from vision) 10 times a second.
+ * The option 'simspeed=N' runs the virtual clock N times faster than
+ * real time (default 10). */
+class USimCore
+{
+public:
+  ~USimCore();
+  /**
+   * Check for sim options, load the track and start the simulation thread.
+   * \returns true if the simulator is used */
+  bool setup(int argc, char **argv);
+  /**
+   * Data sent to the robot, one or more lines (with or without CRC) */
+  void receive(const char * data);
+  /**
+   * Stop the simulation thread */
+  void stop();
+  /**
+   * Load track file (see above)
+   * \returns false if the file is not found or has no lines */
+  bool loadTrack(const char * file);
+  /**
+   * Run a mission without bridge and real time, as fast as possible
+   * (as used by the mission sweep tool).
+   * \param mission is the mission lines (without 'regbot madd')
+   * \param maxTime is the maximum (virtual) mission time (sec)
+   * \param time is set to the mission time
+   * \param margin is set to the smallest distance (m) from a followed line edge
+   * to the end of the line sensor, 0 if the line is lost while following it
+   * \returns true if the mission finished (event 0) before maxTime */
+  bool runOffline(const vector<string> & mission, float maxTime, float & time, float & margin);
+  /// simulator is used
+  bool active = false;
+
+private:
+  /**
+   * A mission condition, like 'dist=0.5' or 'xl > 16' */
+  class UCondition
+  {
+  public:
+    string name;
+    char op;
+    float value;
+  };
+  /**
+   * A decoded mission line */
+  class USimLine
+  {
+  public:
+    string text;
+    /// assignments (name and value)
+    vector<pair<string, float>> assign;
+    vector<UCondition> conditions;
+    int label = -1;
+    int gotoLabel = -1;
+    int event = -1;
+    /// goto count so far
+    int count = 0;
+  };
+  /// a line segment in the track
+  class USegment
+  {
+  public:
+    float x1, y1, x2, y2;
+  };
+  /// an ArUco marker in the track
+  class USimMarker
+  {
+  public:
+    int id;
+    float x, y, h;
+  };
+  /// decode a mission line, returns false if not valid
+  bool decodeLine(const char * line, USimLine & m);
+  /// handle one command line (without CRC)
+  void command(const char * line);
+  /// start a mission line
+  void startLine();
+  /// test if the current line is finished
+  bool lineFinished();
+  /// continue to next line (or goto), ends the mission after the last line
+  void nextLine();
+  /// value for a sensor condition, known is false if not simulated
+  float conditionValue(const string & name, bool & known);
+  /// print a warning for a name that is not simulated (once)
+  void warnOnce(const string & name);
+  /// move robot one time step
+  void step(float dt);
+  /// find line sensor values (lv, xl and edge positions)
+  void lineSensor();
+  /// distance to nearest wall along a ray from robot center
+  float irDistance(float angle);
+  /// markers seen by the simulated camera, returns number of markers
+  int camera(UArucoResult & r);
+  /// send a message to the bridge decode (CRC is added)
+  void send(const char * msg);
+  /// simulation thread
+  static void startloop(USimCore * sim);
+  void run();
+  //
+  vector<USimLine> lines;
+  vector<USegment> tape;
+  vector<USegment> walls;
+  vector<USimMarker> markers;
+  /// current mission line (-1 if no mission is running)
+  int current = -1;
+  /// virtual time (sec)
+  double t = 0;
+  /// robot pose and velocity
+  float x = 0, y = 0, h = 0;
+  float startX = 0, startY = 0, startH = 0;
+  /// odometry pose (as reported), and heading drift (rad/m)
+  float ox = 0, oy = 0, oh = 0;
+  float drift = 0;
+  float vel = 0;
+  float turnRate = 0;
+  /// mission values (kept from line to line)
+  float velRef = 0;
+  float acc = 1.0;
+  /// drive mode for this line: 0 = straight, 1 = turn radius, 2 = edge
+  int mode = 0;
+  float turnRadius = 0;
+  /// edge: -1 right, 1 left, with offset (cm)
+  int edge = 0;
+  float edgeOffset = 0;
+  float headRef = 0;
+  /// driven, turned (radians) and time on this line
+  float lineDist = 0;
+  float lineTurn = 0;
+  float lineTime = 0;
+  /// line sensor
+  int lv = 0;
+  int xl = 0;
+  /// lateral position of the line (meter, left positive)
+  float lineLeft = 0, lineRight = 0;
+  /// smallest line margin in edge mode since mission start
+  float minMargin = 0;
+  /// control state 0 = idle, 2 = mission running
+  int controlState = 0;
+  /// virtual time speed-up
+  float speed = 10;
+  /// messages to send when the lock is released
+  vector<string> outbox;
+  /// warnings for not simulated names, given once
+  vector<string> warned;
+  thread * simThread = nullptr;
+  bool terminate = false;
+  mutex dataLock;
+  /// robot geometry: line sensor distance in front and half width, wheel base
+  static constexpr float SENSOR_DIST = 0.15;
+  static constexpr float SENSOR_HALF_WIDTH = 0.06;
+  static const int SENSOR_CNT = 16;
+  static constexpr float TAPE_WIDTH = 0.02;
+  static constexpr float WHEEL_BASE = 0.19;
+  static constexpr float IR_MAX = 1.5;
+  /// camera range (m) and half field of view (radians)
+  static constexpr float CAM_RANGE = 2.0;
+  static constexpr float CAM_HALF_FOV = 0.5;
+  /// simulation time step (virtual time)
+  static constexpr float DT = 0.005;
+};
+
+/**
+ * Make this visible to the rest of the software */
+extern USimCore simcore;
+
+#endif
@@ -0,0 +1,238 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, 
+ * Author:
+ * Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+#include <stdio.h>
+#include <math.h>
+#include "utrigger.h"
+#include "upose.h"
+#include "utime.h"
+
+// create value
+UTrigger triggers;
+
+
+int UTrigger::add(UTriggerItem & item)
+{
+  dataLock.lock();
+  item.id = nextId++;
+  items.push_back(item);
+  activeCnt = items.size();
+  dataLock.unlock();
+  return item.id;
+}
+
+int UTrigger::addRegion(float x1, float y1, float x2, float y2, function<void()> callback, bool once)
+{
+  UTriggerItem item;
+  item.type = REGION;
+  item.v[0] = fminf(x1, x2);
+  item.v[1] = fminf(y1, y2);
+  item.v[2] = fmaxf(x1, x2);
+  item.v[3] = fmaxf(y1, y2);
+  item.once = once;
+  item.callback = callback;
+  return add(item);
+}
+
+int UTrigger::addHeading(float heading, function<void()> callback, bool once)
+{
+  UTriggerItem item;
+  item.type = HEADING;
+  item.v[0] = heading;
+  item.once = once;
+  item.callback = callback;
+  return add(item);
+}
+
+int UTrigger::addDistance(float dist, function<void()> callback)
+{
+  UTriggerItem item;
+  item.type = DISTANCE;
+  item.v[0] = dist;
+  item.once = true;
+  item.callback = callback;
+  return add(item);
+}
+
+int UTrigger::addThreshold(function<float()> value, float limit, bool above, function<void()> callback, bool once)
+{
+  UTriggerItem item;
+  item.type = THRESHOLD;
+  item.v[0] = limit;
+  item.v[1] = above;
+  item.once = once;
+  item.value = value;
+  item.callback = callback;
+  return add(item);
+}
+
+void UTrigger::remove(int id)
+{
+  dataLock.lock();
+  for (int i = 0; i < (int)items.size(); i++)
+  {
+    if (items[i].id == id)
+    {
+      items.erase(items.begin() + i);
+      break;
+    }
+  }
+  activeCnt = items.size();
+  dataLock.unlock();
+}
+
+void UTrigger::clear()
+{
+  dataLock.lock();
+  items.clear();
+  activeCnt = 0;
+  dataLock.unlock();
+}
+
+bool UTrigger::test(UTriggerItem & item, bool newPose, float dd)
+{
+  bool now;
+  bool fire = false;
+  switch (item.type)
+  {
+    case REGION:
+      if (not newPose)
+        return false;
+      now = poseX >= item.v[0] and poseX <= item.v[2] and poseY >= item.v[1] and poseY <= item.v[3];
+      fire = now and not item.last and not item.first;
+      break;
+    case HEADING:
+    {
+      if (not newPose)
+        return false;
+      float d = poseH - item.v[0];
+      if (d > M_PI)
+        d -= 2 * M_PI;
+      else if (d < -M_PI)
+        d += 2 * M_PI;
+      now = d >= 0;
+      // a sign change on the opposite side (at +/- pi) is not a crossing
+      fire = now != item.last and fabsf(d) < M_PI / 2 and not item.first;
+      break;
+    }
+    case DISTANCE:
+      if (not newPose)
+        return false;
+      item.driven += dd;
+      now = item.driven >= item.v[0];
+      fire = now;
+      break;
+    case THRESHOLD:
+    {
+      float v = item.value();
+      if (item.v[1] != 0)
+        now = v > item.v[0];
+      else
+        now = v < item.v[0];
+      fire = now and not item.last;
+      break;
+    }
+  }
+  item.last = now;
+  item.first = false;
+  return fire;
+}
+
+void UTrigger::evaluate()
+{
+  UTime t;
+  t.now();
+  // copy the pose, as it is written by the bridge decode
+  pose.dataLock.lock();
+  double pt = pose.t;
+  float px = pose.x, py = pose.y, ph = pose.h;
+  pose.dataLock.unlock();
+  dataLock.lock();
+  bool newPose = pt != poseTime;
+  float dd = 0;
+  if (newPose)
+  { // the baseline is updated with no triggers too,
+    // so that a new distance trigger counts from the current pose
+    if (poseValid)
+    {
+      dd = hypotf(px - poseX, py - poseY);
+      // a jump is an odometry reset, not a distance
+      if (dd > 0.5)
+        dd = 0;
+    }
+    poseTime = pt;
+    poseX = px;
+    poseY = py;
+    poseH = ph;
+    poseValid = true;
+  }
+  if (activeCnt == 0)
+  {
+    dataLock.unlock();
+    return;
+  }
+  for (int i = 0; i < (int)items.size(); )
+  {
+    testCnt++;
+    if (test(items[i], newPose, dd))
+    {
+      fired.push_back(items[i].callback);
+      firedCnt++;
+      if (items[i].once)
+      {
+        items.erase(items.begin() + i);
+        continue;
+      }
+    }
+    i++;
+  }
+  activeCnt = items.size();
+  dataLock.unlock();
+  // callbacks may add or remove triggers, so called without the lock
+  for (function<void()> & f : fired)
+  {
+    float latency = t.getTimePassed();
+    fireLatencySum += latency;
+    if (latency > fireLatencyMax)
+      fireLatencyMax = latency;
+    f();
+  }
+  fired.clear();
+  float dt = t.getTimePassed();
+  evalCnt++;
+  evalTimeSum += dt;
+  if (dt > evalTimeMax)
+    evalTimeMax = dt;
+}
+
+void UTrigger::printStats()
+{
+  printf("# UTrigger:: %d active, %d tests, %d fired\n", (int)activeCnt, testCnt, firedCnt);
+  if (evalCnt > 0)
+    printf("# UTrigger:: evaluate %.1f us mean, %.1f us max (incl. callbacks), %d messages\n",
+           evalTimeSum / evalCnt * 1e6, evalTimeMax * 1e6, evalCnt);
+  if (firedCnt > 0)
+    printf("# UTrigger:: evaluate to callback %.1f us mean, %.1f us max\n",
+           fireLatencySum / firedCnt * 1e6, fireLatencyMax * 1e6);
+}
@@ -0,0 +1,124 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#ifndef UTRIGGER_H
+#define UTRIGGER_H
+
+#include <functional>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+using namespace std;
+
+/**
+ * Triggers tested on the host when data arrives from the robot, like
+ * the conditions in a mission line, but with a callback, e.g.
+ *   triggers.addRegion(1.0, -0.2, 1.5, 0.2, [](){ bridge.tx("regbot mclear\n"); });
+ * All active triggers are tested in the bridge receive thread, right
+ * after each message is decoded, so callbacks must be short (no waiting).
+ * A callback may add or remove triggers. */
+class UTrigger
+{
+public:
+  /**
+   * Fire when the robot enters a rectangle (odometry coordinates).
+   * Fires on the first pose inside after a pose outside.
+   * \returns trigger ID (for remove) */
+  int addRegion(float x1, float y1, float x2, float y2, function<void()> callback, bool once = true);
+  /**
+   * Fire when the heading passes this value (radians), in any direction */
+  int addHeading(float heading, function<void()> callback, bool once = true);
+  /**
+   * Fire when the robot has driven this distance (meter) from now,
+   * forward or reverse, measured on the pose updates */
+  int addDistance(float dist, function<void()> callback);
+  /**
+   * Fire when a value passes a limit, e.g.
+   *   triggers.addThreshold([](){ return state.batteryVoltage; }, 11.0, false, cb);
+   * \param value gets the value, called for every decoded message
+   * \param above if true fire when value gets above limit, else below */
+  int addThreshold(function<float()> value, float limit, bool above, function<void()> callback, bool once = true);
+  /**
+   * Remove a trigger (no problem if it is fired and removed already) */
+  void remove(int id);
+  /**
+   * Remove all triggers */
+  void clear();
+  /**
+   * Test all triggers, called by the bridge after each decoded message */
+  void evaluate();
+  /**
+   * Print number of tests and fired triggers, and the time used
+   * in the bridge receive thread (evaluate to callback called) */
+  void printStats();
+
+private:
+  enum TriggerType {REGION, HEADING, DISTANCE, THRESHOLD};
+  class UTriggerItem
+  {
+  public:
+    int id;
+    TriggerType type;
+    bool once;
+    /// region (x1,y1,x2,y2), heading (v[0]) or distance (v[0]) or limit (v[0])
+    float v[4];
+    /// last test result (inside region, value above limit, heading sign)
+    bool last = false;
+    /// first test not done yet
+    bool first = true;
+    /// driven distance so far
+    float driven = 0;
+    function<float()> value;
+    function<void()> callback;
+  };
+  int add(UTriggerItem & item);
+  /// test one trigger, returns true if fired
+  bool test(UTriggerItem & item, bool newPose, float dd);
+  vector<UTriggerItem> items;
+  int nextId = 1;
+  /// pose used at last evaluation
+  double poseTime = 0;
+  float poseX = 0, poseY = 0, poseH = 0;
+  bool poseValid = false;
+  /// callbacks to call after the test
+  vector<function<void()>> fired;
+  /// number of triggers, the tests are skipped when there are none
+  atomic<int> activeCnt{0};
+  int testCnt = 0;
+  int firedCnt = 0;
+  /// evaluate calls with active triggers, and time used (sec)
+  int evalCnt = 0;
+  float evalTimeSum = 0;
+  float evalTimeMax = 0;
+  /// time from evaluate start to callback called (sec)
+  float fireLatencySum = 0;
+  float fireLatencyMax = 0;
+  mutex dataLock;
+};
+
+/**
+ * Make this visible to the rest of the software */
+extern UTrigger triggers;
+
+#endif
@@ -26,7 +26,11 @@
 #include <string.h>
 #include "ubridge.h"
 #include "uvision.h"
+#include "uscheduler.h"
 #include "utime.h"
+#include "upose.h"
+#include "uimagesink.h"
+#include "ulocalize.h"
 #include <opencv2/imgproc.hpp>
 #include <opencv2/core/types.hpp>
 
@@ -50,8 +54,17 @@ void UVision::setup(int argc, char **argv)
       saveImage = true;
     if (strcmp(argv[i], "ball") == 0)
       findBall = true;
+    if (strcmp(argv[i], "line") == 0)
+      findLine = true;
     if (strcmp(argv[i], "aruco") == 0)
       findAruco = true;
+    if (strcmp(argv[i], "contour") == 0)
+      useContours = true;
+    if (strcmp(argv[i], "nogate") == 0)
+      motionGate = false;
+    if (strcmp(argv[i], "camauto") == 0)
+      // do not use saved exposure settings
+      camAuto = true;
     if (strcmp(argv[i], "show") == 0)
       showImage = true;
     if (strncmp(argv[i], "video", 5) == 0)
@@ -60,66 +73,162 @@ void UVision::setup(int argc, char **argv)
       p1 += 5;
       dev = strtol(p1, nullptr, 10);
     }
+    if (strncmp(argv[i], "file=", 5) == 0)
+      // use image sequence or video file in place of camera
+      strncpy(fileName, &argv[i][5], MFL - 1);
+    if (strncmp(argv[i], "cvthreads=", 10) == 0)
+      // 1 runs OpenCV functions in the calling thread (no parallel_for_ jobs)
+      cv::setNumThreads(strtol(&argv[i][10], nullptr, 10));
+  }
+  // open camera or image file
+  openTime.now();
+  if (fileName[0] != '\0')
+    camIsOpen = frameSource.openFile(fileName);
+  else
+  {
+    camIsOpen = frameSource.openCamera(dev);
+    if (camIsOpen)
+    { // use exposure from last run, if available
+      if (not camAuto and frameSource.loadSettings(cameraSettingsFile))
+        warmupFrames = 2;
+      else
+      { // use auto exposure, the file then gets the auto state (not the stale exposure)
+        frameSource.setAuto();
+        settingsToSave = true;
+      }
+    }
   }
-  // prepare to open camera
-  int deviceID = dev;             // 0 = open default camera
-  int apiID = cv::CAP_V4L2;  //cv::CAP_ANY;  // 0 = autodetect default API
-  // open selected camera using selected API
-//   cap.set(cv::CAP_PROP_FRAME_WIDTH, 1280);
-  cap.open(deviceID, apiID);
   // check if we succeeded
-  camIsOpen = cap.isOpened();
   if (not camIsOpen)
   {
     cerr << "ERROR! Unable to open camera\n";
   }
   else
   {
-    uint32_t fourcc = cv::VideoWriter::fourcc('M','J','P','G'); 
-    cap.set(cv::CAP_PROP_FOURCC, fourcc);
-    // possible resolutions in JPEG coding
-    // (rows x columns) 320x640, 720x1280
-    cap.set(cv::CAP_PROP_FRAME_HEIGHT, 720); // 320
-    cap.set(cv::CAP_PROP_FRAME_WIDTH, 1280); // 640
-//     cap.set(cv::CAP_PROP_FRAME_HEIGHT, 320); // 320
-//     cap.set(cv::CAP_PROP_FRAME_WIDTH, 640); // 640
-    cap.set(cv::CAP_PROP_FPS, 25); // 640
-    union FourChar
-    {
-      uint32_t cc4;
-      char ccc[4];
-    } fmt;
-    fmt.cc4 = cap.get(cv::CAP_PROP_FOURCC);
-    printf("# Video device %d: width=%g, height=%g, format=%c%c%c%c, FPS=%g\n", 
-           dev, 
-           cap.get(cv::CAP_PROP_FRAME_WIDTH), 
-           cap.get(cv::CAP_PROP_FRAME_HEIGHT), 
-           fmt.ccc[0], fmt.ccc[1], fmt.ccc[2], fmt.ccc[3], 
-           cap.get(cv::CAP_PROP_FPS));
-    //
     // start thread to keep buffer empty
     printf("# Vision::setup: Starting image capture loop\n");
     listener = new thread(startloop, this);
   }
   // generate projection matrix
+  makeCamToRobot();
+  tracker.setup(focalLength);
+  if (findAruco)
+    aruco.setup();
+  colours.print();
+  if ((findLine or findAruco) and camIsOpen)
+    // the line detector is for stream mode only, and markers
+    // are used for localization while the missions run
+    startStreaming(false, findLine);
+  //
+}
+
+void UVision::makeCamToRobot()
+{ // generate projection matrix
   float st = sin(camTilt);
   float ct = cos(camTilt);
   camToRobot = (cv::Mat1f(4,4) << ct,  0.f, st, camPos[0],
                                   0.f ,  1.f, 0.f , camPos[1],
                                   -st, 0.f, ct, camPos[2],
                                   0.f ,  0.f, 0.f , 1.f);
-  //
 }
 
-void UVision::stop()
+void UVision::setCalibration(float focal, float x, float y, float z, float tilt, float k1, float k2)
+{
+  focalLength = focal;
+  camPos[0] = x;
+  camPos[1] = y;
+  camPos[2] = z;
+  camTilt = tilt;
+  lensK1 = k1;
+  lensK2 = k2;
+  makeCamToRobot();
+  // tracker and floor map are updated when needed
+  trackWidth = 0;
+  calibSerial++;
+}
+
+const cv::Mat2f & UVision::getFloorMap(cv::Size imageSize)
 {
-  if (camIsOpen)
+  if (floorMapSerial == calibSerial and floorMap.size() == imageSize)
+    return floorMap;
+  UTime t;
+  t.now();
+  floorMap.create(imageSize.height, imageSize.width);
+  // focal length scales with image width
+  float f = focalLength * imageSize.width / float(calibWidth);
+  float cx = imageSize.width / 2.0f;
+  float cy = imageSize.height / 2.0f;
+  float st = sin(camTilt);
+  float ct = cos(camTilt);
+  const float maxRange = 5.0; // meters
+  for (int r = 0; r < imageSize.height; r++)
   {
+    cv::Vec2f * p = floorMap[r];
+    for (int c = 0; c < imageSize.width; c++)
+    { // normalized image coordinates
+      float u = (c - cx) / f;
+      float v = (r - cy) / f;
+      if (lensK1 != 0 or lensK2 != 0)
+      { // remove radial distortion (a few fixed-point iterations)
+        float ud = u, vd = v;
+        for (int i = 0; i < 5; i++)
+        {
+          float r2 = u * u + v * v;
+          float k = 1 + lensK1 * r2 + lensK2 * r2 * r2;
+          u = ud / k;
+          v = vd / k;
+        }
+      }
+      // ray in camera coordinates (x forward, y left, z up)
+      // rotated to robot coordinates (as camToRobot)
+      float dx = ct * 1 + st * -v;
+      float dy = -u;
+      float dz = -st * 1 + ct * -v;
+      // distance along ray to floor (z = 0)
+      float k = -camPos[2] / dz;
+      float x = camPos[0] + k * dx;
+      float y = camPos[1] + k * dy;
+      if (dz < 0 and hypotf(x, y) < maxRange)
+        *p = cv::Vec2f(x, y);
+      else
+        *p = cv::Vec2f(NAN, NAN);
+      p++;
+    }
+  }
+  floorMapSerial = calibSerial;
+  printf("# Vision: made floor map for %dx%d image in %.3f sec\n", imageSize.width, imageSize.height, t.getTimePassed());
+  return floorMap;
+}
+
+bool UVision::floorPosition(int col, int row, cv::Size imageSize, cv::Vec2f & pos)
+{
+  if (col < 0 or row < 0 or col >= imageSize.width or row >= imageSize.height)
+    return false;
+  pos = getFloorMap(imageSize)(row, col);
+  return not std::isnan(pos[0]);
+}
+
+void UVision::stop()
+{
+  if (streaming)
+    stopStreaming();
+  if (camIsOpen or frameSource.isOpen())
+  { // the capture loop may have closed at end of file
     camIsOpen = false;
     // allow last frame to finish
     usleep(300000);
+    if (streamer != NULL)
+    { // stream loop ends when camera is closed
+      streamer->join();
+      streamer = NULL;
+    }
+    if (not frameSource.manualSettings and frameSource.saveSettings(cameraSettingsFile))
+      // the exposure in use can not be read in auto mode, so this saves the auto state
+      printf("# Vision: saved camera settings to %s\n", cameraSettingsFile);
+    // finish saving debug images
+    imageSink.stop();
     // close
-    cap.release();
+    frameSource.release();
   }
 }
 
@@ -137,20 +246,117 @@ void UVision::loop()
 {
   while (camIsOpen and not terminate)
   { // keep framebuffer empty
-    if (useFrame)
-    { // grab and decode next image
-      cap.read(frame);
+    if (modeRequested)
+      applyCaptureMode();
+    if (autoRequested)
+    { // auto exposure needs some frames to settle
+      frameSource.setAuto();
+      warmupFrames = frameSerial + 20;
+      settingsToSave = true;
+      autoRequested = false;
+    }
+    if (frameSource.isFile and not useFrame)
+    { // a file is not real time, so use every frame
+      usleep(1000);
+      continue;
+    }
+    // just grab the image
+    bool grabbed = frameSource.grab();
+    UTime grabTime;
+    grabTime.now();
+    if (not grabbed and frameSource.isFile)
+    {
+      printf("# Vision::loop: end of file '%s' after %d frames\n", frameSource.name, frameSource.frameCnt);
+      camIsOpen = false;
+      break;
+    }
+    if (useFrame and grabbed)
+    { // decode the grabbed image
+      frameSource.retrieve(frame);
+      frameTime = grabTime;
+      frameSerialUsed = frameSerial;
       // mark as available
       gotFrame = not frame.empty();
       useFrame = not gotFrame;
     }
-    else
-      // just grab the image - mark it as used
-      cap.grab();
+    if (frameSerial == warmupFrames and grabbed)
+    {
+      if (not firstFrameReported)
+      {
+        printf("# Vision: first usable frame after %.3f sec from open (%s exposure)\n",
+               openTime.getTimePassed(), frameSource.manualSettings ? "saved" : "auto");
+        firstFrameReported = true;
+      }
+      if (settingsToSave and frameSource.saveSettings(cameraSettingsFile))
+      {
+        printf("# Vision: saved camera settings to %s\n", cameraSettingsFile);
+        settingsToSave = false;
+      }
+    }
     frameSerial++;
   }
 }
 
+bool UVision::setCaptureMode(int width, int height, float fps, const char * fourcc, bool wait)
+{
+  if (not camIsOpen or frameSource.isFile)
+    return false;
+  dataLock.lock();
+  modeWidth = width;
+  modeHeight = height;
+  modeFps = fps;
+  if (fourcc != nullptr)
+    strncpy(modeFormat, fourcc, 4);
+  else
+    modeFormat[0] = '\0';
+  modeRequested = true;
+  dataLock.unlock();
+  if (not wait)
+    return true;
+  UTime t;
+  t.now();
+  while (modeRequested and t.getTimePassed() < 2.0 and camIsOpen)
+    usleep(3000);
+  return not modeRequested;
+}
+
+void UVision::autoExposure()
+{
+  if (camIsOpen and not frameSource.isFile)
+    autoRequested = true;
+}
+
+bool UVision::captureModeReady()
+{
+  return not modeRequested;
+}
+
+void UVision::applyCaptureMode()
+{ // called by the capture loop only
+  dataLock.lock();
+  int w = modeWidth;
+  int h = modeHeight;
+  float fps = modeFps;
+  char fmt[5];
+  strncpy(fmt, modeFormat, 5);
+  dataLock.unlock();
+  UTime t;
+  t.now();
+  bool ok = frameSource.setMode(w, h, fps, fmt[0] == '\0' ? nullptr : fmt);
+  // time includes the first frame in the new mode
+  cv::Mat img;
+  for (int i = 0; i < 25 and ok; i++)
+  {
+    if (frameSource.read(img) and img.cols == w)
+      break;
+  }
+  modeSwitchTime = t.getTimePassed();
+  printf("# Vision: capture mode %dx%d, %g fps, format %s in %.3f sec (%s)\n",
+         frameSource.width, frameSource.height, frameSource.fps, frameSource.format,
+         modeSwitchTime, ok ? "ok" : "failed");
+  modeRequested = false;
+}
+
 bool UVision::getNewestFrame()
 { // request new frame
   gotFrame = false;
@@ -171,12 +377,24 @@ bool UVision::processImage(float seconds)
 { // process images in 'seconds' seconds
   UTime t, t2, t3, t4; // for timing
   t.now();
+  if (streaming)
+  { // the stream loop owns the camera frames, so just wait for a result with a ball
+    UVisionResult r;
+    while (t.getTimePassed() < seconds and camIsOpen and not terminate)
+    {
+      if (getResult(r) and r.ballCnt > 0)
+        break;
+      usleep(5000);
+    }
+    return terminate or not camIsOpen;
+  }
   int n = 0;
   int frameCnt = 0;
   float frameSampleTime = 1.5; // seconds
   while (t.getTimePassed() < seconds and camIsOpen and not terminate and n < 5)
-  { // skip the first 20 frames to allow auto-illumination to work
-    if (t4.getTimePassed() > frameSampleTime and frameSerial > 20)
+  { // skip the first frames to allow auto-illumination to work
+    // (few frames if exposure is from the settings file)
+    if (t4.getTimePassed() > frameSampleTime and (frameSerial > warmupFrames or frameSource.isFile))
     { // do every 1.5 second (or sample time)
       t4.now();
       getNewestFrame();    
@@ -185,20 +403,14 @@ bool UVision::processImage(float seconds)
         printf("# got frame %d (%d) t=%.3f sec, dt=%.3f sec, size %dx%d\n", frameCnt, frameSerial, t.getTimePassed(), t2.getTimePassed(), frame.rows, frame.cols);
         t2.now();
         if (showImage)
-        {
-          t3.now();
-          cv::imshow("raw image", frame);
-          printf("Image show call took %.3f sec\n", t3.getTimePassed());
-          cv::waitKey(300);
-        }
+          // shown by the image sink thread
+          imageSink.show("raw image", frame);
         if (saveImage)
-        { // save the image - with a number
+        { // save the image - with a number (lossless, for test of image processing)
           const int MSL = 100;
           char s[MSL];
           snprintf(s, MSL, "sandberg_%03d.png", n);
-          t3.now();
-          cv::imwrite(s, frame);
-          printf("Image save took %.3f sec\n", t3.getTimePassed());
+          imageSink.save(s, frame);
         }
         if (findBall and n > 2)
         {
@@ -211,6 +423,8 @@ bool UVision::processImage(float seconds)
             ballProjectionAndTest();
           }
         }
+        if (findAruco)
+          doFindAruco();
         frameCnt++;
       }
       n++;
@@ -222,47 +436,341 @@ bool UVision::processImage(float seconds)
   return terminate or not camIsOpen;
 }
 
-int UVision::uvDistance(cv::Vec3b pix, cv::Vec3b col)
-{ /// format is Y,V,U and Y is not used
-  /// returns 0 for total match
-  /// returns (block) distance in U,V space between pixel (pix) and color (col)
-  /// returns at maximum 255
-  int d = abs(pix[1] - col[1]) + abs(pix[2] - col[2]);
-  if (d > 255)
-    d = 255;
-  else if (d < 0)
-    d = 0;
-  return d;
+bool UVision::startStreaming(bool balls, bool lines)
+{ // process every newest frame in a separate thread
+  if (not camIsOpen)
+  {
+    printf("# Vision::startStreaming: camera is not open\n");
+    return false;
+  }
+  if (balls)
+    findBall = true;
+  if (lines)
+    findLine = true;
+  // printing details for every frame takes too long
+  verbose = false;
+  streamFrameCnt = 0;
+  gateSkipCnt = 0;
+  lastThumb.release();
+  streamFirstSerial = frameSerial;
+  streamLatencySum = 0;
+  streamLatencyMax = 0;
+  fullSearchTimeSum = 0;
+  fullSearchCnt = 0;
+  roiSearchTimeSum = 0;
+  roiSearchCnt = 0;
+  lineTimeSum = 0;
+  lineCnt = 0;
+  lineDetect.reset();
+  arucoTimeSum = 0;
+  arucoCnt = 0;
+  tracker.reset();
+  streamStart.now();
+  streaming = true;
+  startStreamThread();
+  printf("# Vision::startStreaming: stream mode started\n");
+  return true;
 }
 
+bool UVision::startStreamThread()
+{
+  if (streamer == NULL and camIsOpen)
+    streamer = new thread(startStreamLoop, this);
+  return streamer != NULL;
+}
 
-bool UVision::doFindBall()
+void UVision::stopStreaming()
+{
+  unique_lock<mutex> lock(streamLock);
+  streaming = false;
+  // wait for the last frame to finish
+  streamIdle.wait(lock, [this](){ return not streamBusy; });
+  lock.unlock();
+  printStreamStats();
+}
+
+bool UVision::getResult(UVisionResult & newest)
+{
+  return result.get(newest);
+}
+
+bool UVision::getLine(ULineResult & newest)
+{
+  return lineResult.get(newest);
+}
+
+bool UVision::getMarkers(UArucoResult & newest)
+{
+  return arucoResult.get(newest);
+}
+
+void UVision::printStreamStats()
+{
+  float dt = streamStart.getTimePassed();
+  int captured = frameSerial - streamFirstSerial;
+  if (streamFrameCnt > 0 and dt > 0)
+    printf("# Vision stream: %d of %d frames processed in %.1f sec (%.1f fps), latency mean %.1f ms, max %.1f ms\n",
+           streamFrameCnt, captured, dt, streamFrameCnt / dt,
+           streamLatencySum / streamFrameCnt * 1000, streamLatencyMax * 1000);
+  else
+    printf("# Vision stream: no frames processed\n");
+  if (motionGate and captured > 0)
+    printf("# Vision stream: motion gate skipped %d frames, processed %.2f frames per captured frame\n",
+           gateSkipCnt, float(streamFrameCnt) / captured);
+  if (fullSearchCnt > 0 and roiSearchCnt > 0)
+  { // saving by tracking
+    float full = fullSearchTimeSum / fullSearchCnt * 1000;
+    float part = roiSearchTimeSum / roiSearchCnt * 1000;
+    printf("# Vision stream: full image search %.1f ms (%d frames), tracked ROI search %.1f ms (%d frames), saving %.1f ms/frame\n",
+           full, fullSearchCnt, part, roiSearchCnt, full - part);
+  }
+  if (fullSearchCnt + roiSearchCnt > 0)
+    workspace.printStats("Vision stream: ball detect");
+  if (arucoCnt > 0)
+    printf("# Vision stream: ArUco detect %.2f ms/frame (%d frames)\n",
+           arucoTimeSum / arucoCnt * 1000, arucoCnt);
+  if (lineCnt > 0)
+    printf("# Vision stream: line detect %.2f ms/frame (%d frames), %d crossings since start\n",
+           lineTimeSum / lineCnt * 1000, lineCnt, lineCrossingCnt);
+}
+
+std::future<UVisionResult> UVision::findBallsAsync(float timeout)
+{
+  UVisionRequest req;
+  std::future<UVisionResult> f = req.promise.get_future();
+  if (not camIsOpen or terminate)
+  { // no images, so return an empty result now
+    req.promise.set_value(UVisionResult());
+    return f;
+  }
+  findBall = true;
+  req.deadline.now();
+  req.deadline += timeout;
+  requestLock.lock();
+  requests.push_back(std::move(req));
+  requestLock.unlock();
+  startStreamThread();
+  return f;
+}
+
+void UVision::completeRequests(UVisionResult & r, bool gotResult)
+{ // complete requests with found balls, or when timed out
+  requestLock.lock();
+  UTime t;
+  t.now();
+  auto it = requests.begin();
+  while (it != requests.end())
+  {
+    if ((gotResult and r.ballCnt > 0) or t > it->deadline or not camIsOpen or terminate)
+    {
+      it->promise.set_value(r);
+      it = requests.erase(it);
+    }
+    else
+      it++;
+  }
+  requestLock.unlock();
+}
+
+void UVision::startStreamLoop(UVision* vision)
+{ // start stream mode loop (thread)
+  vision->streamLoop();
+}
+
+void UVision::streamLoop()
+{
+  UVisionResult empty;
+  while (camIsOpen and not terminate)
+  {
+    requestLock.lock();
+    bool requested = not requests.empty();
+    requestLock.unlock();
+    // busy until this frame is processed, see stopStreaming()
+    streamLock.lock();
+    streamBusy = streaming or requested;
+    streamLock.unlock();
+    if (streamBusy)
+    { // when the robot stands still, the image is checked at a low rate only
+      bool gate = motionGate and not requested and not frameSource.isFile;
+      bool moving = robotMoving();
+      if (gate and not moving and gateCheckTime.getTimePassed() < gateInterval)
+        usleep(5000);
+      // get the newest frame - older frames are dropped by the capture loop
+      else if (getNewestFrame())
+      {
+        gateCheckTime.now();
+        // make a thumbnail always, so that it is ready when the robot stops
+        bool changed = not motionGate or sceneChanged();
+        if (not gate or moving or changed)
+        {
+          streamProcess();
+          // this is the reference for the next scene change
+          if (motionGate)
+            cv::swap(thumb, lastThumb);
+        }
+        else
+          gateSkipCnt++;
+      }
+      else if (requested)
+        // no frame, but requests may have timed out
+        completeRequests(empty, false);
+      streamLock.lock();
+      streamBusy = false;
+      streamLock.unlock();
+      streamIdle.notify_all();
+    }
+    else
+      usleep(5000);
+  }
+  streamLock.lock();
+  streamBusy = false;
+  streamLock.unlock();
+  streamIdle.notify_all();
+  // complete any remaining requests
+  completeRequests(empty, false);
+}
+
+bool UVision::robotMoving()
+{
+  pose.dataLock.lock();
+  float v = pose.vel;
+  float w = pose.turnRate;
+  pose.dataLock.unlock();
+  return fabsf(v) > gateVel or fabsf(w) > gateTurnRate;
+}
+
+bool UVision::sceneChanged()
+{ // compare a small version of the image with the last processed image
+  cv::resize(frame, thumb, cv::Size(64, 36), 0, 0, cv::INTER_AREA);
+  if (lastThumb.size() != thumb.size())
+    return true;
+  cv::absdiff(thumb, lastThumb, thumbDiff);
+  cv::Scalar m = cv::mean(thumbDiff);
+  // average difference for all colours
+  sceneDiff = (m[0] + m[1] + m[2]) / 3;
+  return sceneDiff > gateDiff;
+}
+
+void UVision::streamProcess()
+{ // image is in 'frame'
+  UVisionResult r;
+  r.frameSerial = frameSerialUsed;
+  r.imageTime = frameTime;
+  ballBoundingBox.clear();
+  ballPosition.clear();
+  if (findLine)
+  { // line first, as it is fast and needed at full frame rate
+    ULineResult lr;
+    lr.frameSerial = frameSerialUsed;
+    lr.imageTime = frameTime;
+    lineDetect.detect(frame, getFloorMap(frame.size()), lr);
+    lineResult.publish(lr);
+    scheduler.notify();
+    lineTimeSum += lineDetect.scanTime;
+    lineCnt++;
+    lineCrossingCnt = lr.crossingCnt;
+  }
+  if (findAruco)
+  {
+    doFindAruco();
+    arucoTimeSum += aruco.thresholdTime + aruco.quadTime + aruco.decodeTime;
+    arucoCnt++;
+  }
+  if (findBall)
+  { // search near the tracked ball only, full image at a low rate
+    pose.dataLock.lock();
+    float heading = pose.h;
+    pose.dataLock.unlock();
+    if (frame.cols != trackWidth)
+    { // new capture mode (or calibration), focal length scales with image width
+      tracker.setup(focalLength * frame.cols / float(calibWidth));
+      trackWidth = frame.cols;
+    }
+    tracker.predict(frameTime, heading);
+    bool full = tracker.needFullSearch();
+    cv::Rect roi;
+    if (not full)
+      roi = tracker.roi(frame.size());
+    UTime t;
+    t.now();
+    doFindBall(roi);
+    float dt = t.getTimePassed();
+    if (full)
+    {
+      fullSearchTimeSum += dt;
+      fullSearchCnt++;
+      r.searchArea = cv::Rect(0, 0, frame.cols, frame.rows);
+    }
+    else
+    {
+      roiSearchTimeSum += dt;
+      roiSearchCnt++;
+      r.searchArea = roi;
+    }
+    tracker.update(ballBoundingBox);
+    ballProjectionAndTest();
+    r.trackValid = tracker.valid;
+    r.trackPos = tracker.pos;
+    r.trackVel = tracker.vel;
+    r.trackDiameter = tracker.diameter;
+  }
+  r.ballCnt = std::min((int)ballBoundingBox.size(), (int)UVisionResult::MAX_BALLS);
+  for (int i = 0; i < r.ballCnt; i++)
+  {
+    r.ballBox[i] = ballBoundingBox[i];
+    r.ballPos[i] = ballPosition[i];
+    r.ballOnFloor[i] = ballOnFloor[i];
+  }
+  r.doneTime.now();
+  result.publish(r);
+  scheduler.notify();
+  completeRequests(r, true);
+  // statistics
+  float latency = r.latency();
+  streamFrameCnt++;
+  streamLatencySum += latency;
+  if (latency > streamLatencyMax)
+    streamLatencyMax = latency;
+}
+
+bool UVision::doFindBall(cv::Rect roi)
 { // process pipeline to find
   // bounding boxes of balls with matched colour
-  cv::Mat yuv;
-  cv::imwrite("rgb_balls_01.png", frame);
-  cv::cvtColor(frame, yuv, cv::COLOR_BGR2YUV);
+  UTime t;
+  t.now();
+  cv::Mat img = frame;
+  if (not roi.empty())
+    img = frame(roi);
+  // all scratch images are from the workspace, so no image memory is allocated
+  // for these in steady state
+  workspace.newFrame();
+  if (ballBoundingBox.capacity() < UVisionResult::MAX_BALLS)
+  { // candidate lists have a fixed capacity, allocated for the first frame only
+    blobs.reserve(UVisionResult::MAX_BALLS);
+    ballBoundingBox.reserve(UVisionResult::MAX_BALLS);
+    ballPosition.reserve(UVisionResult::MAX_BALLS);
+    ballOnFloor.reserve(UVisionResult::MAX_BALLS);
+  }
+  cv::Size sz = img.size();
+  cv::Mat & yuv = workspace.get(WS_YUV, sz, CV_8UC3);
+  cv::cvtColor(img, yuv, cv::COLOR_BGR2YUV);
   int h = yuv.rows;
   int w = yuv.cols;
-  cv::imwrite("yuv_balls_01.png", yuv);
-  printf("# YUV saved, size width=%d height=%d\n", w, h);
-  //
-  // color for filter
-  cv::Vec3b yuvOrange = cv::Vec3b(128,88,187);
-  cv::Mat gray1(h,w, CV_8UC1);
-  // test all pixels
-  for (int r = 0; r < h; r++)
-  { // get pointers to pixel-row for destination image
-    uchar * pOra = (uchar*) gray1.ptr(r); // gray
-    for (int c = 0; c < w; c++)
-    { // go through all pixels in this row
-      int d;
-      cv::Vec3b p = yuv.at<cv::Vec3b>(r,c);
-      d = uvDistance(p, yuvOrange);
-      *pOra = 255 - d;
-      pOra++; // increase to next destination pixel
-    }
+  if (saveImage)
+  { // saved by the image sink thread
+    imageSink.save("rgb_balls_01.jpg", img);
+    imageSink.save("yuv_balls_01.jpg", yuv);
   }
+  if (verbose)
+    printf("# YUV made, size width=%d height=%d\n", w, h);
+  //
+  // classify all pixels by colour (U,V) using a lookup table,
+  // the colour match is 255 - distance to the class colour
+  cv::Mat & classImg = workspace.get(WS_CLASS, sz, CV_8UC1);
+  cv::Mat & matchImg = workspace.get(WS_MATCH, sz, CV_8UC1);
+  colours.classify(yuv, classImg, matchImg);
+  colourTime = t.getTimePassed();
+  t.now();
   //
 //   // threshold to BW image
 //   if (false)
@@ -280,25 +788,52 @@ bool UVision::doFindBall()
 //     return true;
 //   }
   //
-  // do static threshold at value 230, max is 255 and mode is 3 (zero all pixels below threshold) 
-  cv::Mat gray2;
-  cv::threshold(gray1, gray2, 230, 255, 3);
+  // get match for the ball colour only, the colour table has
+  // zeroed all pixels with a distance over the class limit (25 for orange)
+  cv::Mat & gray2 = workspace.get(WS_GRAY2, sz, CV_8UC1);
+  UColourTable::extract(classImg, matchImg, ballColour, gray2);
   //
   // remove small items with a erode/delate
-  // last parameter is iterations, and could be increased
-  cv::Mat gray3, gray4;
-  cv::erode(gray2, gray3, cv::Mat(), cv::Point(-1,-1), 1);
-  cv::dilate(gray3, gray4, cv::Mat(), cv::Point(-1,-1), 1);
+  // last parameter is iterations, and could be increased.
+  // The images are part of bigger buffers, so
+  // BORDER_ISOLATED is needed to not use pixels outside the image
+  cv::Mat & gray3 = workspace.get(WS_GRAY3, sz, CV_8UC1);
+  cv::Mat & gray4 = workspace.get(WS_GRAY4, sz, CV_8UC1);
+  const int border = cv::BORDER_CONSTANT | cv::BORDER_ISOLATED;
+  cv::erode(gray2, gray3, cv::Mat(), cv::Point(-1,-1), 1, border);
+  cv::dilate(gray3, gray4, cv::Mat(), cv::Point(-1,-1), 1, border);
+  filterTime = t.getTimePassed();
   if (showImage)
   { // show eroded/dilated image
-    cv::imshow("Thresholede image", gray2);
-    cv::imshow("Eroded/dilated image", gray4);
-    cv::waitKey(1000); // 1 second
+    imageSink.show("Thresholede image", gray2);
+    imageSink.show("Eroded/dilated image", gray4);
   }
-  //
-  // find contours for further validation
-  vector<vector<cv::Point> > contours;
-  vector<cv::Vec4i> hierarchy; // not used, but needed
+  // Test for valid blobs
+  if (showImage)
+    frame.copyTo(debugImg); // make copy of original image
+  t.now();
+  int candidateCnt;
+  if (useContours)
+    candidateCnt = findBallContours(gray4, roi);
+  else
+    candidateCnt = findBallBlobs(gray4, roi);
+  segmentTime = t.getTimePassed();
+  if (verbose)
+    printf("Found %d/%d balls filtered for size and average color\n", 
+           (int)ballBoundingBox.size(), candidateCnt);
+  if (showImage)
+  {
+    imageSink.show("Debug image", debugImg);  
+  }
+  workspace.endFrame();
+  return true;
+}
+
+int UVision::findBallContours(const cv::Mat & gray4, cv::Rect roi)
+{ // find contours for further validation
+  // contour storage is reused
+  vector<vector<cv::Point> > & contours = workspace.contours;
+  vector<cv::Vec4i> & hierarchy = workspace.hierarchy; // not used, but needed
   cv::findContours( gray4, contours, hierarchy, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE );
   if (showImage)
   { // show the found contours for debug
@@ -309,17 +844,20 @@ bool UVision::doFindBall()
       cv::Scalar color = cv::Scalar( rng.uniform(0, 256), rng.uniform(0,256), rng.uniform(0,256) );
       cv::drawContours( col4, contours, (int)i, color, 2, cv::LINE_8, hierarchy, 0 );
     }
-    imshow( "Contours", col4);
-    cv::waitKey(1000);
+    imageSink.show("Contours", col4);
   }
-  // Test for valid contours
-  if (showImage)
-    frame.copyTo(debugImg); // make copy of original image
+  // integral images (only the rotated one is used)
+  cv::Size isz(gray4.cols + 1, gray4.rows + 1);
+  cv::Mat & sum = workspace.get(WS_SUM, isz, CV_32SC1);
+  cv::Mat & sqsum = workspace.get(WS_SQSUM, isz, CV_64FC1);
+  cv::Mat & tilted = workspace.get(WS_TILTED, isz, CV_32SC1);
+  bool madeIntegral = false;
   // iterate all contours
   for (int i = 0; i < (int)contours.size(); i++)
   {
     const vector<cv::Point>& ct = contours[i];
-    printf("# Contour %d has %d points\n", i, (int)ct.size());
+    if (verbose)
+      printf("# Contour %d has %d points\n", i, (int)ct.size());
     // find boundingRect
     cv::Rect bb = cv::boundingRect(ct);
     // find longest side of bounding box
@@ -334,56 +872,214 @@ bool UVision::doFindBall()
     if (abs(bb.height - bb.width) < mx / 3 and bb.area() > 200 and mx < 150)
     { // circle is OK so far
       // test if content is the right color too
-      int okPixels = 0;
-      int usedPixelCnt = 0;
-      printf("# Object %d at %d,%d and width=%d, height=%d passed the size criteria\n", i, bb.x, bb.y, bb.width, bb.height);
-      for (int r = 0; r < bb.height; r++)
-      {
-        uchar * pix = (uchar*) gray4.ptr(r + bb.y); // gray
-        pix += bb.x;
-        for (int c = 0; c < bb.width; c++)
-        { // count pixels with right colour not from a circle
-          // but use of a diamond shaped area is faster:
-          // the sum of row and column distance from center 
-          // should be less than half width of bounding box
-          if ((abs(c - mx2) + abs(r - mx2)) < mx2)
-          { // this should be inside the ball, and the colour counts
-            okPixels += *pix; // add the pixel value (230..255, or 0 if not right)
-            pix++; // move to next pixel
-            usedPixelCnt++; // count the pixel for average
-          }
-        }
+      if (verbose)
+        printf("# Object %d at %d,%d and width=%d, height=%d passed the size criteria\n", i, bb.x, bb.y, bb.width, bb.height);
+      if (not madeIntegral)
+      { // summed area tables, made once for all candidates in this image
+        cv::integral(gray4, sum, sqsum, tilted, CV_32S, CV_64F);
+        madeIntegral = true;
       }
-      float avg = (float)okPixels / float(usedPixelCnt*255);
-      printf("#  -- has %d of %d as the right color, average is %g\n", okPixels, (int)bb.area(), avg);
+      // count pixels with right colour not from a circle
+      // but use of a diamond shaped area is faster
+      int okPixels, usedPixelCnt;
+      float avg = diamondAverage(tilted, bb, mx2, okPixels, usedPixelCnt);
+      if (verbose)
+        printf("#  -- has %d of %d as the right color, average is %g\n", okPixels, usedPixelCnt, avg);
       // filter on average color inside bounding box diamond (more than 60% has OK color)
       if (avg > 0.6)
       { // should be counted as OK, add to list of bounding boxes
+        // in full image coordinates
+        bb.x += roi.x;
+        bb.y += roi.y;
         ballBoundingBox.push_back(bb);
         // draw the box on the color image
         if (showImage)
           cv::rectangle(debugImg, bb.tl(), bb.br(), cv::Vec3b(230,0,155), 2 );
+        if ((int)ballBoundingBox.size() >= UVisionResult::MAX_BALLS)
+          // candidate lists are full
+          break;
       }
     }
   }
-  printf("Found %d/%d balls filtered for size and average color\n", 
-         (int)ballBoundingBox.size(), (int)contours.size());
-  if (showImage)
+  return contours.size();
+}
+
+int UVision::findBallBlobs(const cv::Mat & gray4, cv::Rect roi)
+{ // label connected pixels, this gives bounding box, 
+  // pixel count and centroid for all blobs,
+  // labels and statistics use workspace buffers, so nothing is allocated
+  cv::Mat & labels = workspace.get(WS_LABELS, gray4.size(), CV_32SC1);
+  int n = workspace.connectedComponents(gray4, labels);
+  blobs.clear();
+  // integral images (only the rotated one is used)
+  cv::Size isz(gray4.cols + 1, gray4.rows + 1);
+  cv::Mat & sum = workspace.get(WS_SUM, isz, CV_32SC1);
+  cv::Mat & sqsum = workspace.get(WS_SQSUM, isz, CV_64FC1);
+  cv::Mat & tilted = workspace.get(WS_TILTED, isz, CV_32SC1);
+  bool madeIntegral = false;
+  int m = std::min(n, (int)UWorkspace::MAX_COMPONENTS);
+  for (int i = 0; i < m; i++)
   {
-    imshow("Debug image", debugImg);  
+    const UWorkspace::UComponent & u = workspace.component[i];
+    cv::Rect bb(u.left, u.top, u.right - u.left + 1, u.bottom - u.top + 1);
+    int area = u.area;
+    int mx = std::max(bb.width, bb.height);
+    // a ball fills pi/4 of the bounding box
+    float fill = float(area) / float(bb.area());
+    // centroid of a ball is in the middle of the box
+    cv::Point2f ctr(float(u.sumX) / area, float(u.sumY) / area);
+    float dc = hypotf(ctr.x - (bb.x + (bb.width - 1) / 2.0f), ctr.y - (bb.y + (bb.height - 1) / 2.0f));
+    // filter for height and width should be fairly equal - no more than 33% difference
+    // the bounding box should be bigger than 13x13 pixels (area > 200 pixels)
+    // the size should be less than 150 pixels
+    // more than 60% of the box should be filled
+    if (abs(bb.height - bb.width) < mx / 3 and bb.area() > 200 and mx < 150 and 
+        fill > 0.6 and dc < mx / 6.0f)
+    { // test colour in a diamond inside the box, as for contours,
+      // this takes constant time using the tilted integral image
+      if (not madeIntegral)
+      { // summed area tables, made once for all candidates in this image
+        cv::integral(gray4, sum, sqsum, tilted, CV_32S, CV_64F);
+        madeIntegral = true;
+      }
+      int okPixels, usedPixelCnt;
+      float avg = diamondAverage(tilted, bb, mx / 2, okPixels, usedPixelCnt);
+      if (avg <= 0.6)
+      { // less than 60% has OK color
+        if (verbose)
+          printf("# Blob %d at %d,%d rejected, colour match %.2f\n", i, bb.x + roi.x, bb.y + roi.y, avg);
+        continue;
+      }
+      UBlob b;
+      b.area = area;
+      b.colourMatch = avg;
+      // in full image coordinates
+      bb.x += roi.x;
+      bb.y += roi.y;
+      b.box = bb;
+      b.centroid = ctr + cv::Point2f(roi.x, roi.y);
+      if (verbose)
+        printf("# Blob %d at %d,%d and width=%d, height=%d, area=%d (fill %.2f), colour match %.2f\n", 
+               i, bb.x, bb.y, bb.width, bb.height, area, fill, b.colourMatch);
+      blobs.push_back(b);
+      ballBoundingBox.push_back(bb);
+      // draw the box on the color image
+      if (showImage)
+        cv::rectangle(debugImg, bb.tl(), bb.br(), cv::Vec3b(230,0,155), 2 );
+      if ((int)ballBoundingBox.size() >= UVisionResult::MAX_BALLS)
+        // candidate lists are full
+        break;
+    }
   }
-  return true;
+  return n;
+}
+
+void UVision::benchmark(const char * files)
+{ // run the ball pipeline on all frames in a file,
+  // once for each segmentation method (contours and connected components)
+  UFrameSource seq;
+  if (not seq.openFile(files))
+  {
+    printf("# Vision::benchmark: found no images like '%s'\n", files);
+    return;
+  }
+  bool wasVerbose = verbose;
+  bool wasContours = useContours;
+  bool wasShow = showImage;
+  bool wasSave = saveImage;
+  verbose = false;
+  showImage = false;
+  saveImage = false;
+  makeCamToRobot();
+  const int MM = 2; // methods
+  const int MS = 4; // stages
+  const char * name[MM] = {"contours", "connected components"};
+  const char * stage[MS] = {"colour", "filter", "segment", "project"};
+  float stageTime[MM][MS] = {{0}};
+  float totalTime[MM] = {0, 0};
+  int ballCnt[MM] = {0, 0};
+  int onFloorCnt[MM] = {0, 0};
+  int frameWithBallCnt[MM] = {0, 0};
+  int n = 0;
+  UTime t, t2, tAll;
+  tAll.now();
+  while (seq.read(frame))
+  { // make the floor map before timing (made on first frame only)
+    getFloorMap(frame.size());
+    for (int m = 0; m < MM; m++)
+    {
+      useContours = m == 0;
+      ballBoundingBox.clear();
+      t.now();
+      doFindBall();
+      t2.now();
+      ballProjectionAndTest();
+      stageTime[m][3] += t2.getTimePassed();
+      totalTime[m] += t.getTimePassed();
+      stageTime[m][0] += colourTime;
+      stageTime[m][1] += filterTime;
+      stageTime[m][2] += segmentTime;
+      ballCnt[m] += ballBoundingBox.size();
+      for (bool f : ballOnFloor)
+        onFloorCnt[m] += f;
+      frameWithBallCnt[m] += ballBoundingBox.size() > 0;
+    }
+    n++;
+  }
+  if (n > 0)
+  {
+    printf("# Vision benchmark on '%s': %d frames of %dx%d, took %.1f sec\n", 
+           files, n, frame.cols, frame.rows, tAll.getTimePassed());
+    for (int m = 0; m < MM; m++)
+    {
+      printf("# using %s:\n", name[m]);
+      for (int k = 0; k < MS; k++)
+        printf("#    %-8s %7.2f ms/frame\n", stage[k], stageTime[m][k] / n * 1000);
+      printf("#    total    %7.2f ms/frame (%.1f fps)\n", 
+             totalTime[m] / n * 1000, n / totalTime[m]);
+      printf("#    found %d balls (%d on floor) in %d of %d frames\n",
+             ballCnt[m], onFloorCnt[m], frameWithBallCnt[m], n);
+    }
+    workspace.printStats("Vision benchmark: ball detect");
+  }
+  seq.release();
+  verbose = wasVerbose;
+  useContours = wasContours;
+  showImage = wasShow;
+  saveImage = wasSave;
 }
 
+float UVision::diamondAverage(const cv::Mat & tilted, cv::Rect bb, int k, int & okPixels, int & usedPixelCnt)
+{ // the diamond is the pixels with |c - cc| + |r - cr + 0.5| < k,
+  // where (cc,cr) is the center of a 2k x 2k box,
+  // this is 2k^2 pixels (a tilted rectangle with sides k,k)
+  // top corner at (x,y) in the tilted integral image
+  int x = std::min(bb.x, tilted.cols - 2 * k - 2) + k + 1;
+  int y = std::min(bb.y, tilted.rows - 2 * k - 1);
+  okPixels = 0;
+  usedPixelCnt = 2 * k * k;
+  if (k <= 0 or x - k < 0 or y < 0)
+    return 0;
+  okPixels = tilted.at<int>(y, x) 
+           - tilted.at<int>(y + k, x - k) 
+           - tilted.at<int>(y + k, x + k) 
+           + tilted.at<int>(y + 2 * k, x);
+  // pixel values are 230..255 if right colour, else 0
+  return float(okPixels) / float(usedPixelCnt * 255);
+}
 
 void UVision::ballProjectionAndTest()
 {
   bool done = ballBoundingBox.size() == 0;
+  ballPosition.clear();
+  ballOnFloor.clear();
   if (not done)
-  {
+  { // focal length scales with image width
+    float f = focalLength * frame.cols / float(calibWidth);
     for (int i = 0; i < (int)ballBoundingBox.size(); i++)
     {
-      printf("---\n");
+      if (verbose)
+        printf("---\n");
       cv::Rect bb = ballBoundingBox[i];
       float diaPix = std::max(bb.width, bb.height);
       /// use focal length to find distance
@@ -391,42 +1087,56 @@ void UVision::ballProjectionAndTest()
       //       ------ = --------
       //          f        x
       // f = focal length, x = distance to ball
-      float dist = golfBallDiameter * focalLength / float(diaPix);
+      float dist = golfBallDiameter * f / float(diaPix);
       // the position in x (right) and y (down)
       float bbCenter[2] = {bb.x + bb.width/2.0f, bb.y + bb.height/2.0f};
       float frameCenter[2] = {frame.cols/2.0f, frame.rows/2.0f};
       // distance right of image center line - in meters
-      float x = (bbCenter[0] - frameCenter[0])/focalLength * dist;
+      float x = (bbCenter[0] - frameCenter[0])/f * dist;
       // distance below image center line - in meters
-      float y = (bbCenter[1] - frameCenter[1])/focalLength * dist;
+      float y = (bbCenter[1] - frameCenter[1])/f * dist;
       // make a vector of ball center with (x=forward, y=left, z=up)
       cv::Vec4f pos3dcam(dist, -x, -y, 1.0f);
-      printf("# ball %d position in cam   coordinates (x,y,z)=(%.2f, %.2f, %.2f)\n", i, 
+      if (verbose)
+        printf("# ball %d position in cam   coordinates (x,y,z)=(%.2f, %.2f, %.2f)\n", i, 
              pos3dcam[0], pos3dcam[1], pos3dcam[2]);
       // print used matrices and vector
       //  cout << "camToRobot: " << camToRobot << "\n";
       //  cout << "# pos3dcam  : " << pos3dcam << "\n";
-      cv::Mat1f pos3drob = camToRobot * pos3dcam;
-      printf("# ball %d position in robot coordinates (x,y,z)=(%.2f, %.2f, %.2f)\n", i, 
-             pos3drob.at<float>(0), pos3drob.at<float>(1), pos3drob.at<float>(2));
+      // fixed size matrix product, so no matrix is allocated
+      cv::Vec4f pos3drob = cv::Matx44f(camToRobot.ptr<float>()) * pos3dcam;
+      ballPosition.push_back(cv::Vec3f(pos3drob[0], pos3drob[1], pos3drob[2]));
+      if (verbose)
+        printf("# ball %d position in robot coordinates (x,y,z)=(%.2f, %.2f, %.2f)\n", i, 
+             pos3drob[0], pos3drob[1], pos3drob[2]);
+      // test if on the floor: the bottom of the ball projected to the floor
+      // should be at about the same distance as found from the ball size
+      cv::Vec2f floorPos;
+      bool onFloor = false;
+      if (floorPosition(bbCenter[0], bb.y + bb.height - 1, frame.size(), floorPos))
+      {
+        float floorDist = hypotf(floorPos[0], floorPos[1]);
+        float sizeDist = hypotf(pos3drob[0], pos3drob[1]);
+        onFloor = fabsf(floorDist - sizeDist) < 0.25 * sizeDist;
+        if (verbose)
+          printf("# ball %d floor position (x,y)=(%.2f, %.2f), on floor=%d\n", i, floorPos[0], floorPos[1], onFloor);
+      }
+      ballOnFloor.push_back(onFloor);
       //
       if (showImage)
       { // put coordinates in debug image
         const int MSL = 100;
         char s[MSL];
-        snprintf(s, MSL, "Ball %d at x=%.2f, y=%.2f, z=%.2f\n", i, pos3drob.at<float>(0), pos3drob.at<float>(1), pos3drob.at<float>(2));
+        snprintf(s, MSL, "Ball %d at x=%.2f, y=%.2f, z=%.2f\n", i, pos3drob[0], pos3drob[1], pos3drob[2]);
         cv::putText(debugImg, s, cv::Point(bbCenter[0], bbCenter[1]), cv::FONT_HERSHEY_SIMPLEX, 0.4, cv::Scalar(0, 0, 156));
-        //
-        imshow("Debug image", debugImg);
-        if (saveImage)
-          cv::imwrite("annotated_debug_image.jpg", debugImg);          
       }
     }
-  }
-  if (showImage)
-  {
-    printf("# projection done - press key to finish\n");
-    cv::waitKey(0);
+    if (showImage)
+    { // show and save in the image sink thread
+      imageSink.show("Debug image", debugImg);
+      if (saveImage)
+        imageSink.save("annotated_debug_image.jpg", debugImg);
+    }
   }
 }
 
@@ -434,6 +1144,42 @@ void UVision::ballProjectionAndTest()
 
 bool UVision::doFindAruco()
 { // image is in 'frame'
-  printf("# not implemented\n");
-  return false;
+  UArucoResult r;
+  r.frameSerial = frameSerialUsed;
+  r.imageTime = frameTime;
+  // focal length scales with image width
+  float f = focalLength * frame.cols / float(calibWidth);
+  aruco.detect(frame, camToRobot, f, lensK1, lensK2, r);
+  if (verbose)
+  {
+    printf("# ArUco: found %d markers of %d candidates in %.1f ms (threshold %.1f, quads %.1f, decode %.1f ms)\n", 
+           r.markerCnt, aruco.candidateCnt, r.detectTime * 1000, 
+           aruco.thresholdTime * 1000, aruco.quadTime * 1000, aruco.decodeTime * 1000);
+    for (int i = 0; i < r.markerCnt; i++)
+    {
+      const UArucoMarker & m = r.marker[i];
+      printf("# ArUco %d at (x,y,z)=(%.2f, %.2f, %.2f), heading %.1f deg, distance %.2f m\n", 
+             m.id, m.pos[0], m.pos[1], m.pos[2], m.heading * 180 / M_PI, m.dist);
+    }
+  }
+  if (showImage)
+  { // mark the found markers in a copy of the image
+    cv::Mat img = frame.clone();
+    for (int i = 0; i < r.markerCnt; i++)
+    {
+      const UArucoMarker & m = r.marker[i];
+      for (int j = 0; j < 4; j++)
+        cv::line(img, m.corners[j], m.corners[(j + 1) % 4], cv::Scalar(0, 255, 0), 2);
+      const int MSL = 20;
+      char s[MSL];
+      snprintf(s, MSL, "%d", m.id);
+      cv::putText(img, s, m.corners[0], cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(0, 0, 255));
+    }
+    imageSink.show("ArUco", img);
+  }
+  arucoResult.publish(r);
+  // known markers are landmarks for localization
+  localize.onMarkers(r);
+  scheduler.notify();
+  return r.markerCnt > 0;
 }
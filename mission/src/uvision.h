@@ -32,6 +32,9 @@
 #include <netdb.h>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <future>
+#include <list>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -41,10 +44,67 @@
 #include <opencv2/core.hpp>
 #include <opencv2/videoio.hpp>
 #include <opencv2/highgui.hpp>
+#include "utime.h"
+#include "ulatest.h"
+#include "uballtrack.h"
+#include "ucolourtable.h"
+#include "uframesource.h"
+#include "ulinedetect.h"
+#include "uaruco.h"
+#include "uworkspace.h"
 
 using namespace std;
 // forward declaration
 
+/**
+ * Statistics for a connected blob of pixels */
+class UBlob
+{
+public:
+  /// bounding box (pixels)
+  cv::Rect box;
+  /// number of pixels
+  int area;
+  /// center of mass (pixels)
+  cv::Point2f centroid;
+  /// average colour match (0..1) in a diamond inside the box
+  float colourMatch;
+};
+
+/**
+ * Detections from one processed image frame */
+class UVisionResult
+{
+public:
+  static const int MAX_BALLS = 10;
+  /// serial number of the frame (from the capture loop)
+  int frameSerial = -1;
+  /// time the frame was captured
+  UTime imageTime;
+  /// time the result was published
+  UTime doneTime;
+  /// number of found balls
+  int ballCnt = 0;
+  /// bounding box of found balls (in pixels)
+  cv::Rect ballBox[MAX_BALLS];
+  /// ball position in robot coordinates (x (forward), y (left), z (up)) in meters
+  cv::Vec3f ballPos[MAX_BALLS];
+  /// ball is on the floor (projected size and floor position match)
+  bool ballOnFloor[MAX_BALLS];
+  /// a ball is tracked (stream mode)
+  bool trackValid = false;
+  /// tracked ball center and diameter (pixels)
+  cv::Point2f trackPos;
+  float trackDiameter = 0;
+  /// tracked ball velocity in image (pixels per second)
+  cv::Point2f trackVel;
+  /// searched part of the image
+  cv::Rect searchArea;
+  /**
+   * time from image capture to result published (seconds) */
+  float latency() { return doneTime - imageTime; }
+};
+
 class UVision{
   
 public:
@@ -56,17 +116,105 @@ public:
   /**
    * Stream to screen - if any screen is available */
   bool processImage(float seconds);
+  /**
+   * Start continuous detection on every newest frame (stream mode).
+   * Results are available with getResult().
+   * \param balls enables the ball detector
+   * \param lines enables the line and crossing detector
+   * \returns false if camera is not open */
+  bool startStreaming(bool balls = true, bool lines = false);
+  /**
+   * Stop stream mode and print statistics */
+  void stopStreaming();
+  /**
+   * Get the newest detection result from stream mode - never blocks.
+   * NB! only one (mission) thread should use this function.
+   * \param result is set to the newest result (frameSerial is -1 if none)
+   * \returns true if the result is new since last call */
+  bool getResult(UVisionResult & result);
+  /**
+   * Get the newest line and crossing result from stream mode - never blocks.
+   * NB! only one (mission) thread should use this function.
+   * \param result is set to the newest result (frameSerial is -1 if none)
+   * \returns true if the result is new since last call */
+  bool getLine(ULineResult & result);
+  /**
+   * Get the newest ArUco markers from stream mode (or processImage) - never blocks.
+   * NB! only one (mission) thread should use this function.
+   * \param result is set to the newest result (frameSerial is -1 if none)
+   * \returns true if the result is new since last call */
+  bool getMarkers(UArucoResult & result);
+  /**
+   * Print stream mode statistics (fps and latency) */
+  void printStreamStats();
+  /**
+   * Look for balls without blocking the calling thread.
+   * The vision thread processes the newest frames until a ball is found or
+   * the timeout has passed, and then completes the returned future.
+   * \param timeout is the maximum search time in seconds.
+   * \returns a future with the first result with balls,
+   * or the last (empty) result on timeout (ballCnt is 0). */
+  std::future<UVisionResult> findBallsAsync(float timeout);
+  /**
+   * Run the ball detection pipeline on all frames in a file and print
+   * time for each stage, total time and detection count, for both
+   * segmentation methods (contours and connected components).
+   * \param files is an image file sequence, like "sandberg_%03d.png", or a video file */
+  void benchmark(const char * files);
+  /**
+   * Change camera capture mode, e.g. high resolution for ball search
+   * and low resolution (at a higher frame rate) for line following.
+   * The capture thread makes the change between two frames. The camera
+   * driver needs some time for this, so call early with wait=false to
+   * do the switch while the mission does something else.
+   * \param width,height is image size in pixels
+   * \param fps is frames per second
+   * \param fourcc is image format, e.g. "MJPG", or nullptr for no change
+   * \param wait if true, then wait for the first frame in the new mode (max 2 seconds)
+   * \returns false if camera is not open (or, when waiting, mode is not ready) */
+  bool setCaptureMode(int width, int height, float fps, const char * fourcc = nullptr, bool wait = true);
+  /**
+   * \returns true when the last requested capture mode is in use */
+  bool captureModeReady();
+  /**
+   * Use automatic exposure and white balance (again).
+   * The settled values are saved to the camera settings file after 20 frames */
+  void autoExposure();
+  /**
+   * File with exposure, gain and white balance from last run.
+   * If the file exists, the settings are used at open, and
+   * no frames are needed for auto exposure to settle */
+  const char * cameraSettingsFile = "camera_settings.txt";
+  /// time used by last capture mode switch, to first frame in new mode (seconds)
+  float modeSwitchTime = 0;
   /**
    * Close camera */
   void stop();
-  /// camera open flag
+  /// camera (or file) open flag
   bool camIsOpen = false;
+  /// image sequence or video file to use in place of camera (if not empty)
+  static const int MFL = 200;
+  char fileName[MFL] = "";
   /// stream images to client (e.g. over ssh)
   bool saveImage = false;
   /// Shutting down
   bool terminate = false;
   /// show image to X-terminal
   bool showImage = false;
+  /// print details for every processed frame
+  bool verbose = true;
+  /**
+   * In stream mode, skip frames while the robot stands still (velocity
+   * from odometry) and the image is unchanged (difference of a small image).
+   * Pending findBallsAsync requests are always processed. */
+  bool motionGate = true;
+  /// robot is moving above this velocity (m/s) or turn rate (rad/s)
+  float gateVel = 0.01;
+  float gateTurnRate = 0.02;
+  /// image is changed if the average pixel difference is above this value
+  float gateDiff = 4;
+  /// time between checks for image change when not moving (seconds)
+  float gateInterval = 0.2;
   /**
     * images for manual function using slider */
   cv::Mat dest;
@@ -74,14 +222,46 @@ public:
   int slider1;
   int slider2;
   /**
-   * focal length for Sandberg camera in pixels */
-  const int focalLength = 1008;
+   * focal length for Sandberg camera in pixels (at calibWidth image width) */
+  float focalLength = 1008;
+  int calibWidth = 1280;
   const float golfBallDiameter = 0.043; // meter
   /**
    * camera position in robot coordinates (x (forward), y (left), z (up)) */
-  const float camPos[3] = {0.13,-0.02, 0.23};       // in meters
-  const float camTilt = 22 * M_PI / 180; // in radians
+  float camPos[3] = {0.13,-0.02, 0.23};       // in meters
+  float camTilt = 22 * M_PI / 180; // in radians
+  /**
+   * radial lens distortion coefficients (0 is no distortion) */
+  float lensK1 = 0;
+  float lensK2 = 0;
   cv::Mat1f camToRobot;
+  /**
+   * Change camera calibration.
+   * The projection matrix is updated, and the floor map is rebuilt when used.
+   * \param focal is focal length in pixels (at calibWidth image width)
+   * \param x,y,z is camera position in robot coordinates (meters)
+   * \param tilt is camera tilt (down is positive) in radians
+   * \param k1,k2 is radial lens distortion */
+  void setCalibration(float focal, float x, float y, float z, float tilt, float k1 = 0, float k2 = 0);
+  /**
+   * Get map from image pixel to floor position (x,y) in robot coordinates.
+   * The map is made when first used, or when the calibration or image size is changed.
+   * Pixels above the horizon (or too far away) are NaN.
+   * NB! use from the image processing thread only.
+   * \param imageSize is the image size the map should fit. */
+  const cv::Mat2f & getFloorMap(cv::Size imageSize);
+  /**
+   * Floor position seen at an image pixel (using the floor map)
+   * \param col,row is the pixel position
+   * \param imageSize is the size of the image
+   * \param pos is set to floor position (x (forward), y (left)) in robot coordinates (meters)
+   * \returns false if outside image or above horizon */
+  bool floorPosition(int col, int row, cv::Size imageSize, cv::Vec2f & pos);
+  /**
+   * Colour classes for all targets (U,V lookup table) */
+  UColourTable colours;
+  /// colour class used by the ball detector
+  int ballColour = UColourTable::ORANGE;
 //   const float st = sin(camTilt);
 //   const float ct = cos(camTilt);
 //   const cv::Mat1f camToRobot( cos(camTilt),  0.f, st, camPos[0];
@@ -92,8 +272,8 @@ public:
 private:
   /// buffer for captured image
   cv::Mat frame;
-  /// openCV video capture function
-  cv::VideoCapture cap;
+  /// camera or file with frames
+  UFrameSource frameSource;
   /// thread to keep buffer empty
   thread * listener = NULL; /// thread for listen loop
   static void startloop(UVision * vision); /// To spawn the listen loop as a separate thread, it needs to be static
@@ -102,26 +282,148 @@ private:
   bool useFrame = false; /// flag to transfer newest image to 'frame' buffer
   bool gotFrame = false; /// flag for the newest image is available in 'frame'
   int frameSerial = 0;
+  UTime frameTime; /// capture time of image in 'frame'
+  /// requested capture mode, applied by the capture loop
+  bool modeRequested = false;
+  int modeWidth = 0;
+  int modeHeight = 0;
+  float modeFps = 0;
+  char modeFormat[5] = "";
+  void applyCaptureMode();
+  /// frames to skip after open, for exposure to settle
+  int warmupFrames = 20;
+  /// do not use saved camera settings
+  bool camAuto = false;
+  bool autoRequested = false;
+  /// save camera settings when exposure has settled
+  bool settingsToSave = false;
+  UTime openTime;
+  bool firstFrameReported = false;
+  /// image width used by the ball tracker
+  int trackWidth = 0;
+  int frameSerialUsed = 0; /// serial number of image in 'frame'
   mutex dataLock;
   //
+  // stream mode
+  bool streaming = false;
+  /// stream loop is using 'frame' (set with streamLock)
+  bool streamBusy = false;
+  mutex streamLock;
+  condition_variable streamIdle;
+  thread * streamer = NULL; /// thread for stream mode processing
+  bool startStreamThread();
+  static void startStreamLoop(UVision * vision);
+  void streamLoop(); /// process newest frame while streaming
+  void streamProcess(); /// detect and publish result from 'frame'
+  /// robot is moving (from odometry)
+  bool robotMoving();
+  /// 'frame' is different from the last processed frame
+  bool sceneChanged();
+  /// small image of 'frame', and of last processed frame
+  cv::Mat thumb, lastThumb, thumbDiff;
+  float sceneDiff = 0;
+  UTime gateCheckTime;
+  int gateSkipCnt = 0;
+  ULatest<UVisionResult> result; /// newest result
+  /**
+   * Pending asynchronous requests */
+  class UVisionRequest
+  {
+  public:
+    std::promise<UVisionResult> promise;
+    UTime deadline;
+  };
+  list<UVisionRequest> requests;
+  mutex requestLock;
+  void completeRequests(UVisionResult & r, bool gotResult);
+  // stream mode statistics
+  UTime streamStart;
+  int streamFrameCnt = 0;
+  int streamFirstSerial = 0;
+  float streamLatencySum = 0;
+  float streamLatencyMax = 0;
+  /// line and crossing detector for stream mode
+  ULineDetect lineDetect;
+  bool findLine = false;
+  ULatest<ULineResult> lineResult; /// newest line result
+  float lineTimeSum = 0;
+  int lineCnt = 0;
+  int lineCrossingCnt = 0;
+  /// ball tracker for stream mode, limits search to a region of interest
+  UBallTrack tracker;
+  /// search time for full image and for region of interest
+  float fullSearchTimeSum = 0;
+  int fullSearchCnt = 0;
+  float roiSearchTimeSum = 0;
+  int roiSearchCnt = 0;
+  //
   //
   bool findBall = false;
-  bool doFindBall();
+  /**
+   * Find balls in 'frame'
+   * \param roi is the part of the image to search, full image if empty */
+  bool doFindBall(cv::Rect roi = cv::Rect());
+  /**
+   * Find ball candidates using contours (slower, but old method)
+   * \returns number of contours */
+  int findBallContours(const cv::Mat & gray4, cv::Rect roi);
+  /**
+   * Find ball candidates using connected component statistics
+   * \param gray4 is cleaned colour match
+   * \returns number of blobs (connected components) */
+  int findBallBlobs(const cv::Mat & gray4, cv::Rect roi);
+  /// use contours for segmentation, else connected components
+  bool useContours = false;
+  /// time used for colour classification, filtering and segmentation in last image (seconds)
+  float colourTime = 0;
+  float filterTime = 0;
+  float segmentTime = 0;
+  /// blobs accepted as balls in last image
+  vector<UBlob> blobs;
+  /**
+   * Scratch images for ball detection, reused for all frames.
+   * Used by the image processing thread only */
+  UWorkspace workspace;
+  enum WorkspaceSlots {WS_YUV, WS_CLASS, WS_MATCH, WS_GRAY2, WS_GRAY3, WS_GRAY4, 
+                       WS_LABELS, WS_SUM, WS_SQSUM, WS_TILTED};
   cv::Mat debugImg;
   /**
    * Bounding boc for found balls */
   vector<cv::Rect> ballBoundingBox;
+  /**
+   * Ball positions in robot coordinates, same order as ballBoundingBox */
+  vector<cv::Vec3f> ballPosition;
+  /// ball is on the floor, same order as ballBoundingBox
+  vector<bool> ballOnFloor;
   void ballProjectionAndTest();
+  /**
+   * Average pixel value (0..1) in a diamond shaped area inside a bounding box.
+   * Takes constant time using a tilted (rotated) integral image.
+   * \param tilted is the tilted integral image (CV_32S) of a 0..255 image.
+   * \param bb is the bounding box (top-left corner is used).
+   * \param k is the half width of the diamond.
+   * \param okPixels is set to the sum of pixel values in the diamond.
+   * \param usedPixelCnt is set to the number of pixels in the diamond.
+   * \returns the average as okPixels/(usedPixelCnt*255) */
+  float diamondAverage(const cv::Mat & tilted, cv::Rect bb, int k, int & okPixels, int & usedPixelCnt);
+  /// make camToRobot from camera position and tilt
+  void makeCamToRobot();
+  /// floor position for each pixel, made for this calibration and image size
+  cv::Mat2f floorMap;
+  int calibSerial = 0;
+  int floorMapSerial = -1;
   //
   bool findAruco = false;
-  bool doFindAruco();
-  // 
   /**
-   * Calculates color distance between pix and col.
-   * distance 0 is total match, else block distance for U and V only
-   * \returns d = |du| + |dv| */
-  int uvDistance(cv::Vec3b pix, cv::Vec3b col);
-  
+   * Find ArUco markers in 'frame', and publish the result
+   * \returns true if any marker is found */
+  bool doFindAruco();
+  /// marker detector
+  UAruco aruco;
+  ULatest<UArucoResult> arucoResult; /// newest markers
+  float arucoTimeSum = 0;
+  int arucoCnt = 0;
+
 };
 
 /**
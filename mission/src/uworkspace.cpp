@@ -0,0 +1,200 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, 
+ * Author:
+ * Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include "uworkspace.h"
+
+long (*UWorkspace::heapCounter)() = nullptr;
+
+cv::Mat & UWorkspace::get(int slot, cv::Size size, int type)
+{
+  cv::Mat & b = buffer[slot];
+  cv::Mat & v = view[slot];
+  if (v.rows == size.height and v.cols == size.width and v.type() == type)
+    // same as last time
+    return v;
+  if (b.type() != type or b.rows < size.height or b.cols < size.width)
+  { // allocate a buffer that fits this and earlier sizes
+    int rows = size.height;
+    int cols = size.width;
+    if (b.type() == type)
+    {
+      rows = std::max(rows, b.rows);
+      cols = std::max(cols, b.cols);
+    }
+    b.create(rows, cols, type);
+    allocCnt++;
+    if (frameCnt > 1)
+      steadyAllocCnt++;
+  }
+  v = b(cv::Rect(0, 0, size.width, size.height));
+  return v;
+}
+
+void UWorkspace::newFrame()
+{
+  frameCnt++;
+  if (heapCounter != nullptr)
+    heapAtStart = heapCounter();
+}
+
+void UWorkspace::endFrame()
+{
+  if (heapCounter == nullptr)
+    return;
+  int n = heapCounter() - heapAtStart;
+  if (frameCnt > 1)
+  {
+    steadyHeapCnt += n;
+    heapMax = std::max(heapMax, n);
+  }
+}
+
+void UWorkspace::printStats(const char * name)
+{
+  printf("# %s workspace: %d buffer allocations, %d after first frame (%d frames)\n",
+         name, allocCnt, steadyAllocCnt, frameCnt);
+  if (frameCnt > 1 and heapCounter != nullptr)
+    printf("# %s workspace: %.1f heap allocations per frame after first frame (max %d)\n",
+           name, float(steadyHeapCnt) / (frameCnt - 1), heapMax);
+}
+
+int UWorkspace::findRoot(int label)
+{
+  while (parent[label] != label)
+  { // path halving
+    parent[label] = parent[parent[label]];
+    label = parent[label];
+  }
+  return label;
+}
+
+int UWorkspace::connectedComponents(const cv::Mat & bin, cv::Mat & labels)
+{ // two pass labeling, first pass gives provisional labels and
+  // joins touching labels, second pass sums statistics for the joined labels.
+  // a new label needs a free pixel to the left and in the row above,
+  // so there are at most a label for every 2x2 pixels
+  int maxLabels = ((bin.rows + 1) / 2) * ((bin.cols + 1) / 2) + 1;
+  if ((int)parent.size() < maxLabels)
+  {
+    parent.resize(maxLabels);
+    compact.resize(maxLabels);
+    allocCnt++;
+    if (frameCnt > 1)
+      steadyAllocCnt++;
+  }
+  int n = 0;
+  for (int r = 0; r < bin.rows; r++)
+  {
+    const uchar * b = bin.ptr(r);
+    int * lab = labels.ptr<int>(r);
+    const int * up = r > 0 ? labels.ptr<int>(r - 1) : nullptr;
+    for (int c = 0; c < bin.cols; c++)
+    {
+      if (b[c] == 0)
+      {
+        lab[c] = 0;
+        continue;
+      }
+      int l = 0;
+      if (c > 0)
+        l = lab[c - 1];
+      if (up != nullptr)
+      { // the three pixels above
+        for (int k = std::max(c - 1, 0); k <= std::min(c + 1, bin.cols - 1); k++)
+        {
+          if (up[k] == 0 or up[k] == l)
+            continue;
+          if (l == 0)
+            l = up[k];
+          else
+          { // join, the lowest label is the root
+            int ra = findRoot(l);
+            int rb = findRoot(up[k]);
+            if (ra < rb)
+              parent[rb] = ra;
+            else
+              parent[ra] = rb;
+          }
+        }
+      }
+      if (l == 0)
+      { // new label
+        l = ++n;
+        parent[l] = l;
+      }
+      lab[c] = l;
+    }
+  }
+  // number the components, a root is always lower than its members
+  int cnt = 0;
+  for (int l = 1; l <= n; l++)
+  {
+    int root = findRoot(l);
+    if (root == l)
+    {
+      if (cnt < MAX_COMPONENTS)
+      {
+        UComponent & u = component[cnt];
+        u.left = bin.cols;
+        u.top = bin.rows;
+        u.right = -1;
+        u.bottom = -1;
+        u.area = 0;
+        u.sumX = 0;
+        u.sumY = 0;
+      }
+      compact[l] = cnt++;
+    }
+    else
+      compact[l] = compact[root];
+  }
+  // statistics
+  for (int r = 0; r < bin.rows; r++)
+  {
+    const int * lab = labels.ptr<int>(r);
+    for (int c = 0; c < bin.cols; c++)
+    {
+      if (lab[c] == 0)
+        continue;
+      int k = compact[lab[c]];
+      if (k >= MAX_COMPONENTS)
+        continue;
+      UComponent & u = component[k];
+      if (c < u.left)
+        u.left = c;
+      if (c > u.right)
+        u.right = c;
+      if (r < u.top)
+        u.top = r;
+      u.bottom = r;
+      u.area++;
+      u.sumX += c;
+      u.sumY += r;
+    }
+  }
+  return cnt;
+}
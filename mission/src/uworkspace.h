@@ -0,0 +1,117 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#ifndef UWORKSPACE_H
+#define UWORKSPACE_H
+
+#include <vector>
+#include <opencv2/core.hpp>
+
+using namespace std;
+
+/**
+ * Scratch images for an image processing pipeline, reused from frame to frame.
+ * Each buffer (slot) is allocated when first used, and is reallocated
+ * only if a bigger image (or another type) is needed, a smaller image
+ * (e.g. a region of interest) uses the top-left part of the buffer.
+ * This way, no scratch image memory is allocated in steady state.
+ * Connected components are found using preallocated label and
+ * statistics buffers too, so the blob segmentation allocates nothing.
+ * NB! a workspace must be used by one thread only. */
+class UWorkspace
+{
+public:
+  /**
+   * Get scratch image
+   * \param slot is the buffer number (0..MAX_SLOTS-1)
+   * \param size is the needed image size
+   * \param type is the image type (e.g. CV_8UC1)
+   * \returns reference to an image of this size and type - content is undefined.
+   * OpenCV functions with this image as output will not allocate new memory. */
+  cv::Mat & get(int slot, cv::Size size, int type);
+  /**
+   * Note the start of a new frame (for statistics) */
+  void newFrame();
+  /**
+   * Note the end of the frame, counts heap allocations in the frame,
+   * if a heap counter is set */
+  void endFrame();
+  /**
+   * Find 8-connected components of non-zero pixels, with statistics.
+   * Uses the workspace union-find buffers, and fills component[],
+   * so nothing is allocated in steady state (unlike cv::connectedComponentsWithStats).
+   * \param bin is the image to segment, zero is background.
+   * \param labels is a CV_32SC1 image of the same size, set to (provisional) labels.
+   * \returns number of components, only the first MAX_COMPONENTS are in component[] */
+  int connectedComponents(const cv::Mat & bin, cv::Mat & labels);
+  /**
+   * Print number of buffer and heap allocations */
+  void printStats(const char * name);
+  /// number of buffer allocations since start
+  int allocCnt = 0;
+  /// number of buffer allocations after the first frame
+  int steadyAllocCnt = 0;
+  /// number of frames
+  int frameCnt = 0;
+  /// heap allocations after the first frame, and max in one frame
+  long steadyHeapCnt = 0;
+  int heapMax = 0;
+  /**
+   * Heap allocation counter, not set in the library.
+   * A debug build of a tool may set this (see tools/visionbench.cpp) */
+  static long (*heapCounter)();
+  /// contour storage, reused
+  vector<vector<cv::Point> > contours;
+  vector<cv::Vec4i> hierarchy;
+  static const int MAX_SLOTS = 12;
+  /**
+   * Statistics for one connected component */
+  class UComponent
+  {
+  public:
+    /// bounding box (pixels, inclusive)
+    int left, top, right, bottom;
+    /// number of pixels
+    int area;
+    /// sum of pixel positions (for the centroid)
+    long sumX, sumY;
+  };
+  static const int MAX_COMPONENTS = 256;
+  /// components found by connectedComponents()
+  UComponent component[MAX_COMPONENTS];
+  
+private:
+  /// allocated buffer
+  cv::Mat buffer[MAX_SLOTS];
+  /// part of the buffer used for this image
+  cv::Mat view[MAX_SLOTS];
+  /// heap allocation count at newFrame()
+  long heapAtStart = 0;
+  /// union-find parent and final component number for provisional labels
+  vector<int> parent;
+  vector<int> compact;
+  /// root of a provisional label
+  int findRoot(int label);
+};
+
+#endif
@@ -0,0 +1,310 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, 
+ * Author:
+ * Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+/**
+ * Mission parameter sweep.
+ * Runs variants of a mission in the simulator (see usimcore.h), with
+ * values in mission lines changed over a range, in parallel worker
+ * processes. The variants are ranked by completion and mission time,
+ * and the Pareto front of time versus line margin is listed.
+ * usage:
+ *   ./missionsweep mission=name [missions=file] [track=file] vary=L:name:from:to:step ...
+ *                  [workers=N] [maxtime=s]
+ * where L is the mission line (1 is first line in the mission), e.g.
+ *   ./missionsweep mission=seesaw track=track.txt vary=6:dist:0.7:0.9:0.05 vary=4:turn:85:95:1 */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "../src/umission.h"
+#include "../src/usimcore.h"
+#include "../src/utime.h"
+
+using namespace std;
+
+/**
+ * A value to change, from the vary=... option */
+class UVary
+{
+public:
+  /// mission line index (from 0)
+  int line;
+  string name;
+  float from, to, step;
+  int count() { return int((to - from) / step + 1.5); }
+};
+
+/**
+ * Result of one variant, as sent from a worker */
+class UResult
+{
+public:
+  int variant;
+  int finished;
+  float time;
+  float margin;
+};
+
+/**
+ * Values for a variant number */
+static void variantValues(vector<UVary> & vary, int variant, vector<float> & values)
+{
+  values.clear();
+  for (UVary & v : vary)
+  {
+    values.push_back(v.from + (variant % v.count()) * v.step);
+    variant /= v.count();
+  }
+}
+
+static string variantText(vector<UVary> & vary, int variant)
+{
+  vector<float> values;
+  variantValues(vary, variant, values);
+  string s;
+  char d[60];
+  for (int i = 0; i < (int)vary.size(); i++)
+  {
+    snprintf(d, 60, " %d:%s=%g", vary[i].line + 1, vary[i].name.c_str(), values[i]);
+    s += d;
+  }
+  return s;
+}
+
+static void printResult(int rank, const UResult & r, vector<UVary> & vary)
+{
+  printf("#   %4d %8.2f %7.2f %s%s\n", rank, r.time, r.margin * 100, 
+         variantText(vary, r.variant).c_str(), r.finished ? "" : " (not finished)");
+}
+
+/**
+ * Run variants variant = worker, worker + workers, ... and write results to fd */
+static void runWorker(int worker, int workers, int total, const vector<string> & base, 
+                      vector<UVary> & vary, const char * track, float maxTime, int fd)
+{
+  USimCore sim;
+  if (track != nullptr)
+    sim.loadTrack(track);
+  vector<UResult> results;
+  vector<float> values;
+  for (int k = worker; k < total; k += workers)
+  {
+    vector<string> lines = base;
+    variantValues(vary, k, values);
+    for (int i = 0; i < (int)vary.size(); i++)
+      UMission::setValue(lines[vary[i].line], vary[i].name.c_str(), values[i]);
+    UResult r;
+    r.variant = k;
+    r.finished = sim.runOffline(lines, maxTime, r.time, r.margin);
+    results.push_back(r);
+  }
+  const char * p1 = (const char *)results.data();
+  int n = results.size() * sizeof(UResult);
+  while (n > 0)
+  {
+    int e = write(fd, p1, n);
+    if (e <= 0)
+      break;
+    p1 += e;
+    n -= e;
+  }
+  close(fd);
+}
+
+int main(int argc, char **argv)
+{
+  const char * name = nullptr;
+  const char * track = nullptr;
+  int workers = sysconf(_SC_NPROCESSORS_ONLN);
+  float maxTime = 60;
+  vector<UVary> vary;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "help") == 0)
+    {
+      printf("# usage:\n#   ./missionsweep mission=name [missions=file] [track=file] vary=L:name:from:to:step ...\n");
+      printf("#                  [workers=N] [maxtime=s]\n");
+      printf("#   L is the line in the mission (1 is the first), name is a value in the line\n");
+      return 0;
+    }
+    else if (strncmp(argv[i], "mission=", 8) == 0)
+      name = &argv[i][8];
+    else if (strncmp(argv[i], "track=", 6) == 0)
+      track = &argv[i][6];
+    else if (strncmp(argv[i], "workers=", 8) == 0)
+      workers = strtol(&argv[i][8], nullptr, 10);
+    else if (strncmp(argv[i], "maxtime=", 8) == 0)
+      maxTime = strtof(&argv[i][8], nullptr);
+    else if (strncmp(argv[i], "vary=", 5) == 0)
+    {
+      UVary v;
+      char n[30];
+      if (sscanf(&argv[i][5], "%d:%29[^:]:%f:%f:%f", &v.line, n, &v.from, &v.to, &v.step) == 5 and v.step > 0)
+      {
+        v.line--;
+        v.name = n;
+        vary.push_back(v);
+      }
+      else
+        printf("# bad vary option '%s' (use vary=L:name:from:to:step)\n", argv[i]);
+    }
+  }
+  if (name == nullptr or not mission.setup(argc, argv))
+  {
+    printf("# missing mission=name or missions file (see help)\n");
+    return 1;
+  }
+  const vector<string> * base = mission.getLines(name);
+  if (base == nullptr)
+  {
+    printf("# mission '%s' not found\n", name);
+    return 1;
+  }
+  int total = 1;
+  for (UVary & v : vary)
+  {
+    string test;
+    if (v.line < 0 or v.line >= (int)base->size() or not UMission::setValue(test = (*base)[v.line], v.name.c_str(), v.from))
+    {
+      printf("# no '%s' in line %d of '%s'\n", v.name.c_str(), v.line + 1, name);
+      return 1;
+    }
+    total *= v.count();
+  }
+  for (int i = 0; i < (int)base->size(); i++)
+    printf("# %2d %s\n", i + 1, (*base)[i].c_str());
+  if (workers < 1)
+    workers = 1;
+  if (workers > total)
+    workers = total;
+  UTime t;
+  t.now();
+  // start worker processes, each with a pipe for the results
+  vector<int> fds;
+  for (int w = 0; w < workers; w++)
+  {
+    int fd[2];
+    if (pipe(fd) != 0)
+    {
+      perror("# pipe");
+      return 1;
+    }
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+      close(fd[0]);
+      runWorker(w, workers, total, *base, vary, track, maxTime, fd[1]);
+      // no global destructors in the worker
+      _exit(0);
+    }
+    close(fd[1]);
+    fds.push_back(fd[0]);
+  }
+  // read from all workers as data arrives, so no worker waits for a full pipe,
+  // a read may end in the middle of a result, the rest comes with the next read
+  vector<UResult> results;
+  vector<pollfd> pfd;
+  for (int fd : fds)
+    pfd.push_back({fd, POLLIN, 0});
+  vector<string> partial(workers);
+  int openCnt = workers;
+  while (openCnt > 0)
+  {
+    if (poll(pfd.data(), pfd.size(), -1) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      perror("# poll");
+      break;
+    }
+    for (int w = 0; w < workers; w++)
+    {
+      if (pfd[w].fd < 0 or pfd[w].revents == 0)
+        continue;
+      char buf[4096];
+      int n = read(pfd[w].fd, buf, sizeof(buf));
+      if (n > 0)
+      { // take all complete results
+        string & s = partial[w];
+        s.append(buf, n);
+        int k = s.size() / sizeof(UResult);
+        for (int i = 0; i < k; i++)
+        {
+          UResult r;
+          memcpy(&r, s.data() + i * sizeof(UResult), sizeof(UResult));
+          results.push_back(r);
+        }
+        s.erase(0, k * sizeof(UResult));
+      }
+      else if (n == 0 or errno != EINTR)
+      { // worker is finished (or failed)
+        if (not partial[w].empty())
+          printf("# worker %d ended with %d bytes of an unfinished result\n", w, (int)partial[w].size());
+        close(pfd[w].fd);
+        pfd[w].fd = -1;
+        openCnt--;
+      }
+    }
+  }
+  while (wait(nullptr) > 0)
+    ;
+  float dt = t.getTimePassed();
+  printf("# sweep of '%s': %d variants by %d workers in %.2f s (%.1f variants/s)\n", 
+         name, (int)results.size(), workers, dt, results.size() / dt);
+  // finished first, then shortest time
+  sort(results.begin(), results.end(), [](const UResult & a, const UResult & b)
+  {
+    if (a.finished != b.finished)
+      return a.finished > b.finished;
+    if (a.time != b.time)
+      return a.time < b.time;
+    return a.margin > b.margin;
+  });
+  int finished = 0;
+  for (UResult & r : results)
+    finished += r.finished;
+  printf("# %d of %d variants finished in %g s\n", finished, (int)results.size(), maxTime);
+  printf("# best variants:\n#   rank time (s) margin (cm) values\n");
+  for (int i = 0; i < (int)results.size() and i < 10; i++)
+    printResult(i + 1, results[i], vary);
+  // Pareto front: no other finished variant is both faster and with more margin
+  printf("# Pareto front (time versus margin):\n#   rank time (s) margin (cm) values\n");
+  float bestMargin = -1;
+  for (int i = 0; i < finished; i++)
+  { // sorted by time, so a variant is on the front if it has more margin than all faster
+    if (results[i].margin > bestMargin)
+    {
+      bestMargin = results[i].margin;
+      printResult(i + 1, results[i], vary);
+    }
+  }
+  return 0;
+}
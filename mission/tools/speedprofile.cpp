@@ -0,0 +1,390 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, 
+ * Author:
+ * Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+/**
+ * Speed profile from a recorded pose log.
+ * Finds the path curvature and slope (tilt) along the driven path, and
+ * the fastest velocity profile where the wheels do not slip (friction
+ * circle) and the acceleration is within limits. The mission lines
+ * are then split where the velocity changes, and new mission lines
+ * (with vel, acc and dist) are printed, with predicted and measured time
+ * for each mission line.
+ * usage:
+ *   ./speedprofile log=pose_file.txt [run=K] [mission=speed] [missions=file]
+ *                  [vmax=1.5] [acc=1.0] [mu=0.4] [minlength=0.3]
+ * where run=K is the K'th mission in the log (from 0, start and end
+ * events are in the log), default is the whole log.
+ * The pose log is saved by the mission app with the 'poselog' option. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include "../src/umission.h"
+
+using namespace std;
+
+/**
+ * One pose from the log */
+class USample
+{
+public:
+  double t;
+  float x, y, h, tilt;
+  /// driven distance from start
+  float s;
+};
+
+/**
+ * Values at one point along the path (equal distance) */
+class UPoint
+{
+public:
+  float s, t, h, tilt;
+  float curvature;
+  /// max velocity from curvature and friction
+  float vlim;
+  /// max velocity, when braking in time for the curves
+  float vb;
+  /// velocity profile (from stand still)
+  float v;
+};
+
+/**
+ * Load pose log, with samples between start (event 33) and end (event 0) of run 'run'
+ * \returns number of runs found in the log */
+static int loadLog(const char * file, int run, vector<USample> & samples)
+{
+  FILE * f = fopen(file, "r");
+  if (f == nullptr)
+    return -1;
+  const int MLL = 200;
+  char line[MLL];
+  int runs = 0;
+  bool use = run < 0;
+  while (fgets(line, MLL, f) != nullptr)
+  {
+    int e;
+    double t;
+    if (sscanf(line, "%% event %d at %lf", &e, &t) == 2)
+    {
+      if (e == 33)
+      {
+        use = run < 0 or run == runs;
+        runs++;
+      }
+      else if (e == 0 and run >= 0)
+        use = false;
+      continue;
+    }
+    USample p;
+    if (line[0] != '%' and use and sscanf(line, "%lf %f %f %f %f", &p.t, &p.x, &p.y, &p.h, &p.tilt) == 5)
+      samples.push_back(p);
+  }
+  fclose(f);
+  return runs;
+}
+
+/**
+ * Resample the path at equal distance, and find curvature (smoothed) */
+static void makePath(vector<USample> & samples, float ds, vector<UPoint> & path)
+{
+  float s = 0;
+  float hu = samples[0].h;
+  samples[0].s = 0;
+  for (int i = 1; i < (int)samples.size(); i++)
+  {
+    s += hypotf(samples[i].x - samples[i - 1].x, samples[i].y - samples[i - 1].y);
+    samples[i].s = s;
+    // unwrap heading
+    float dh = samples[i].h - samples[i - 1].h;
+    if (dh > M_PI)
+      dh -= 2 * M_PI;
+    else if (dh < -M_PI)
+      dh += 2 * M_PI;
+    hu += dh;
+    samples[i].h = hu;
+  }
+  int j = 0;
+  for (float d = 0; d <= s; d += ds)
+  {
+    while (j < (int)samples.size() - 2 and samples[j + 1].s < d)
+      j++;
+    USample & a = samples[j];
+    USample & b = samples[j + 1];
+    float w = 0;
+    if (b.s > a.s)
+      w = (d - a.s) / (b.s - a.s);
+    UPoint p;
+    p.s = d;
+    p.t = a.t + w * (b.t - a.t);
+    p.h = a.h + w * (b.h - a.h);
+    p.tilt = a.tilt + w * (b.tilt - a.tilt);
+    path.push_back(p);
+  }
+  // curvature over +/- 0.1 m
+  int k = int(0.1 / ds + 0.5);
+  int n = path.size();
+  for (int i = 0; i < n; i++)
+  {
+    int i1 = max(0, i - k);
+    int i2 = min(n - 1, i + k);
+    if (i2 > i1)
+      path[i].curvature = (path[i2].h - path[i1].h) / (path[i2].s - path[i1].s);
+    else
+      path[i].curvature = 0;
+  }
+}
+
+/**
+ * Fastest velocity profile with friction circle, slope and acceleration limit.
+ * Positive tilt is taken as uphill (nose up). */
+static void makeProfile(vector<UPoint> & path, float ds, float vmax, float acc, float mu)
+{
+  const float g = 9.82;
+  int n = path.size();
+  for (UPoint & p : path)
+  { // max velocity in a curve
+    float grip = mu * g * cosf(p.tilt);
+    p.vlim = vmax;
+    if (fabsf(p.curvature) > 1e-3)
+      p.vlim = fminf(vmax, sqrtf(grip / fabsf(p.curvature)));
+  }
+  // backward pass (braking before curves)
+  path[n - 1].vb = path[n - 1].vlim;
+  for (int i = n - 2; i >= 0; i--)
+  {
+    UPoint & p = path[i + 1];
+    float grip = mu * g * cosf(p.tilt);
+    float lat = p.vb * p.vb * p.curvature;
+    float a = fminf(acc, sqrtf(fmaxf(0, grip * grip - lat * lat))) + g * sinf(p.tilt);
+    path[i].vb = fminf(path[i].vlim, sqrtf(fmaxf(0, p.vb * p.vb + 2 * a * ds)));
+  }
+  // forward pass (acceleration), from stand still
+  path[0].v = 0;
+  for (int i = 0; i < n - 1; i++)
+  {
+    UPoint & p = path[i];
+    float grip = mu * g * cosf(p.tilt);
+    float lat = p.v * p.v * p.curvature;
+    float a = fminf(acc, sqrtf(fmaxf(0, grip * grip - lat * lat))) - g * sinf(p.tilt);
+    path[i + 1].v = fminf(path[i + 1].vb, sqrtf(fmaxf(0, p.v * p.v + 2 * a * ds)));
+  }
+}
+
+/**
+ * Path index at distance s */
+static int indexAt(vector<UPoint> & path, float ds, float s)
+{
+  int i = int(s / ds + 0.5);
+  return max(0, min((int)path.size() - 1, i));
+}
+
+/**
+ * Predicted time for a mission line part, driven as the robot does:
+ * the velocity changes from v0 towards the commanded velocity
+ * with the acceleration limit.
+ * \param length is the length of the part (m)
+ * \param vel is the commanded velocity (m/s)
+ * \param acc is the acceleration limit (m/s^2)
+ * \param v0 is the velocity at the start, and is set to the velocity at the end
+ * \returns predicted time (s) */
+static float partTime(float length, float vel, float acc, float & v0)
+{
+  // distance to reach the commanded velocity
+  float da = fabsf(vel * vel - v0 * v0) / (2 * acc);
+  float t;
+  if (da >= length)
+  { // velocity is not reached in this part
+    float v1;
+    if (v0 < vel)
+      v1 = sqrtf(v0 * v0 + 2 * acc * length);
+    else
+      v1 = sqrtf(fmaxf(0, v0 * v0 - 2 * acc * length));
+    t = 2 * length / fmaxf(v0 + v1, 0.01);
+    v0 = v1;
+  }
+  else
+  {
+    t = fabsf(vel - v0) / acc + (length - da) / vel;
+    v0 = vel;
+  }
+  return t;
+}
+
+/**
+ * Mission line with vel, acc and condition replaced */
+static string makeLine(const string & line, float vel, float acc, const string & condition)
+{
+  string a = line.substr(0, line.find(':'));
+  char s[30];
+  if (not UMission::setValue(a, "vel", vel))
+  {
+    snprintf(s, 30, "vel=%g,", vel);
+    a = s + a;
+  }
+  if (not UMission::setValue(a, "acc", acc))
+  {
+    snprintf(s, 30, ",acc=%g", acc);
+    a += s;
+  }
+  return a + ":" + condition;
+}
+
+int main(int argc, char **argv)
+{
+  const char * log = nullptr;
+  const char * name = "speed";
+  int run = -1;
+  float vmax = 1.5;
+  float acc = 1.0;
+  float mu = 0.4;
+  float minLength = 0.3;
+  const float ds = 0.02;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "help") == 0)
+    {
+      printf("# usage:\n#   ./speedprofile log=pose_file.txt [run=K] [mission=speed] [missions=file]\n");
+      printf("#                  [vmax=1.5] [acc=1.0] [mu=0.4] [minlength=0.3]\n");
+      printf("#   run=K uses the K'th mission in the log (from 0), default is all\n");
+      printf("#   mu is the friction coefficient, acc the max acceleration (m/s^2)\n");
+      printf("#   minlength is the shortest mission line to make (m)\n");
+      return 0;
+    }
+    else if (strncmp(argv[i], "log=", 4) == 0)
+      log = &argv[i][4];
+    else if (strncmp(argv[i], "run=", 4) == 0)
+      run = strtol(&argv[i][4], nullptr, 10);
+    else if (strncmp(argv[i], "mission=", 8) == 0)
+      name = &argv[i][8];
+    else if (strncmp(argv[i], "vmax=", 5) == 0)
+      vmax = strtof(&argv[i][5], nullptr);
+    else if (strncmp(argv[i], "acc=", 4) == 0)
+      acc = strtof(&argv[i][4], nullptr);
+    else if (strncmp(argv[i], "mu=", 3) == 0)
+      mu = strtof(&argv[i][3], nullptr);
+    else if (strncmp(argv[i], "minlength=", 10) == 0)
+      minLength = strtof(&argv[i][10], nullptr);
+  }
+  vector<USample> samples;
+  int runs = log == nullptr ? -1 : loadLog(log, run, samples);
+  if (runs < 0)
+  {
+    printf("# missing or bad log=file (see help)\n");
+    return 1;
+  }
+  printf("# %d missions in '%s', using %s: %d poses\n", runs, log, run < 0 ? "all" : "one", (int)samples.size());
+  if (samples.size() < 10 or not mission.setup(argc, argv))
+    return 1;
+  const vector<string> * lines = mission.getLines(name);
+  if (lines == nullptr)
+  {
+    printf("# mission '%s' not found\n", name);
+    return 1;
+  }
+  vector<UPoint> path;
+  makePath(samples, ds, path);
+  makeProfile(path, ds, vmax, acc, mu);
+  float total = path.back().s;
+  printf("# path %.2f m, measured %.2f s\n", total, path.back().t - path.front().t);
+  if (acc <= 0)
+    acc = 1.0;
+  // split path in mission lines, lines with 'dist=' have a known length,
+  // a line with another condition ends the path (the last line)
+  float s1 = 0;
+  // velocity at the start of a line, the robot starts from stand still
+  float v0 = 0;
+  float predictedTotal = 0;
+  vector<string> result;
+  printf("# line, length (m), measured (s), predicted (s), mission line\n");
+  for (int k = 0; k < (int)lines->size(); k++)
+  {
+    const string & line = (*lines)[k];
+    size_t colon = line.find(':');
+    if (colon == string::npos or s1 >= total)
+    { // no condition (e.g. servo), or after the logged path
+      result.push_back(line);
+      continue;
+    }
+    string condition = line.substr(colon + 1);
+    float length;
+    bool hasDist = UMission::getValue(condition, "dist", length);
+    if (not hasDist)
+      length = total - s1;
+    float s2 = fminf(total, s1 + length);
+    int i1 = indexAt(path, ds, s1);
+    int i2 = indexAt(path, ds, s2);
+    // split in parts with about the same velocity,
+    // the robot accelerates by itself (acc), but must brake in time
+    float predicted = 0;
+    int c1 = i1;
+    while (c1 < i2)
+    {
+      float vmin = path[c1].vb;
+      float vtop = path[c1].vb;
+      int c2 = c1 + 1;
+      while (c2 < i2)
+      {
+        float lo = fminf(vmin, path[c2].vb);
+        float hi = fmaxf(vtop, path[c2].vb);
+        if (path[c2].s - path[c1].s >= minLength and hi - lo > 0.2 * hi)
+          break;
+        vmin = lo;
+        vtop = hi;
+        c2++;
+      }
+      if (i2 - c2 < int(minLength / ds))
+      { // too short for a line of its own
+        for (; c2 < i2; c2++)
+          vmin = fminf(vmin, path[c2].vb);
+      }
+      // lowest velocity in the part, in steps of 0.05 m/s
+      float v = fmaxf(0.05, floorf(vmin * 20) / 20);
+      // time from the velocity in the new line, not the ideal profile
+      predicted += partTime(path[c2].s - path[c1].s, v, acc, v0);
+      char d[30];
+      if (c2 < i2 or hasDist)
+      {
+        snprintf(d, 30, "dist=%.2f", path[c2].s - path[c1].s);
+        result.push_back(makeLine(line, v, acc, d));
+      }
+      else
+        // keep the condition that ends the last line
+        result.push_back(makeLine(line, v, acc, condition));
+      c1 = c2;
+    }
+    printf("# %2d %6.2f %7.2f %7.2f  %s\n", k + 1, s2 - s1, path[i2].t - path[i1].t, 
+           predicted, line.c_str());
+    predictedTotal += predicted;
+    s1 = s2;
+  }
+  printf("# predicted %.2f s for the new mission lines\n", predictedTotal);
+  printf("# optimized mission lines for [%s]:\n", name);
+  for (const string & s : result)
+    printf("%s\n", s.c_str());
+  return 0;
+}
@@ -0,0 +1,117 @@
+/*  
+ * 
+ * Copyright © 2022 DTU, 
+ * Author:
+ * Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+/**
+ * Vision pipeline benchmark.
+ * Runs the ball detection (and floor projection) on recorded frames,
+ * so that detection time and performance can be compared without a camera.
+ * usage:
+ *   ./visionbench [files] [colour=orange|blue]
+ * where files is an image sequence (default "sandberg_%03d.png",
+ * as saved by 'mission save') or a video file.
+ * A debug build with COUNT_HEAP defined, e.g.
+ *   cmake -DEXTRA_CC_FLAGS=-DCOUNT_HEAP ..
+ * counts heap allocations in each ball detection frame too. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/uvision.h"
+#include "../src/ucolourtable.h"
+
+#ifdef COUNT_HEAP
+#include <atomic>
+#include <new>
+#include "../src/uworkspace.h"
+
+/// all heap allocations (operator new) in this program
+static std::atomic<long> heapCnt(0);
+
+static long heapCount()
+{
+  return heapCnt;
+}
+
+void * operator new(size_t size)
+{
+  heapCnt++;
+  void * p = malloc(size > 0 ? size : 1);
+  if (p == nullptr)
+    throw std::bad_alloc();
+  return p;
+}
+
+void * operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void * p) noexcept
+{
+  free(p);
+}
+
+void operator delete[](void * p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void * p, size_t) noexcept
+{
+  free(p);
+}
+
+void operator delete[](void * p, size_t) noexcept
+{
+  free(p);
+}
+#endif
+
+int main(int argc, char **argv)
+{
+  const char * files = "sandberg_%03d.png";
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "help") == 0)
+    {
+      printf("# usage:\n#   ./visionbench [help] [files] [colour=orange|blue] [cvthreads=N]\n");
+      printf("#   files is an image sequence like sandberg_%%03d.png (default) or a video file\n");
+      return 0;
+    }
+    else if (strcmp(argv[i], "colour=blue") == 0)
+      vision.ballColour = UColourTable::BLUE;
+    else if (strcmp(argv[i], "colour=orange") == 0)
+      vision.ballColour = UColourTable::ORANGE;
+    else if (strncmp(argv[i], "cvthreads=", 10) == 0)
+      // 1 runs OpenCV functions in this thread (no parallel_for_ jobs)
+      cv::setNumThreads(strtol(&argv[i][10], nullptr, 10));
+    else
+      files = argv[i];
+  }
+#ifdef COUNT_HEAP
+  UWorkspace::heapCounter = heapCount;
+#endif
+  vision.benchmark(files);
+  return 0;
+}